@@ -0,0 +1,98 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Generate the built-in name tables of lsusb from a usb.ids file
+#
+# Usage: gen-usb-ids.py usb.ids usb-ids.c
+#
+# The tables are sorted by key, for a binary search, and refer to the
+# names by their offset in one string pool.  They are all const, so they
+# stay in the binary until a lookup faults their pages in.
+
+import sys
+
+# Keep in sync with enum class_kind in names.c
+KIND_CLASS = 1
+KIND_SUBCLASS = 2
+KIND_PROTOCOL = 3
+
+def ishex(s):
+	"Is s a non-empty string of hex digits?"
+	return len(s) > 0 and all(c in "0123456789abcdefABCDEF" for c in s)
+
+def parse(path):
+	"Return the vendor, product and class dicts of the usb.ids at path"
+	vendors = {}
+	products = {}
+	classes = {}
+	mode = None
+	vid = cid = sid = 0
+	with open(path, "rb") as f:
+		for ln in f.read().decode("utf-8", "replace").splitlines():
+			if not ln or ln[0] == '#':
+				continue
+			if ishex(ln[0:4]) and ln[4:6] == "  ":
+				mode = "vendor"
+				vid = int(ln[0:4], 16)
+				vendors[vid] = ln[6:]
+			elif ln.startswith("C ") and ishex(ln[2:4]):
+				mode = "class"
+				cid = int(ln[2:4], 16)
+				classes[KIND_CLASS << 24 | cid << 16] = ln[6:]
+			elif ln[0] != '\t':
+				# Any other section
+				mode = None
+			elif mode == "vendor" and ishex(ln[1:5]) and ln[5:7] == "  ":
+				products[vid << 16 | int(ln[1:5], 16)] = ln[7:]
+			elif mode == "class" and ishex(ln[1:3]) and ln[3:5] == "  ":
+				sid = int(ln[1:3], 16)
+				classes[KIND_SUBCLASS << 24 | cid << 16 | sid << 8] = ln[5:]
+			elif mode == "class" and ln[1] == '\t' and ishex(ln[2:4]) and ln[4:6] == "  ":
+				classes[KIND_PROTOCOL << 24 | cid << 16 | sid << 8 | int(ln[2:4], 16)] = ln[6:]
+	return vendors, products, classes
+
+def c_string(s):
+	"Quote s as a C string literal, leaving only printable ASCII as is"
+	out = '"'
+	for b in s.encode("utf-8"):
+		c = chr(b)
+		if c in '"\\?' or b < 0x20 or b > 0x7e:
+			out += "\\%03o" % b
+		else:
+			out += c
+	return out + '"'
+
+def main(argv):
+	if len(argv) != 3:
+		print("Usage: %s usb.ids usb-ids.c" % argv[0], file=sys.stderr)
+		return 1
+	tables = parse(argv[1])
+
+	pool = {}
+	strings = []
+	size = 0
+	for table in tables:
+		for name in table.values():
+			if name not in pool:
+				pool[name] = size
+				strings.append(name)
+				size += len(name.encode("utf-8")) + 1
+
+	with open(argv[2], "w") as out:
+		out.write("/* Generated by gen-usb-ids.py from %s, do not edit */\n\n" % argv[1])
+		out.write("#include <stdint.h>\n#include <stddef.h>\n\n#include \"usb-ids.h\"\n\n")
+		out.write("const char usb_ids_strings[] =\n")
+		for name in strings:
+			out.write("\t%s \"\\0\"\n" % c_string(name))
+		out.write("\t\"\";\n")
+		for name, table in zip(("vendors", "products", "classes"), tables):
+			out.write("\nconst struct usb_ids_entry usb_ids_%s[] = {\n" % name)
+			for key in sorted(table):
+				out.write("\t{ 0x%08x, %u },\n" % (key, pool[table[key]]))
+			if not table:
+				out.write("\t{ 0, 0 },\n")
+			out.write("};\nconst size_t usb_ids_n%s = %u;\n" % (name, len(table)))
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Direct reader for the systemd hardware database, hwdb.bin
+ *
+ * libudev builds a list of all the properties of a modalias for every
+ * query, to be searched and thrown away.  This walks the trie of the
+ * mapped file instead, keeping only the wanted property, and returns it
+ * without copying.  The format and the search follow systemd's
+ * hwdb-internal.h and sd-hwdb.c.
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hwdb.h"
+
+static const char *const hwdb_paths[] = {
+	"/etc/systemd/hwdb/hwdb.bin",
+	"/etc/udev/hwdb.bin",
+	"/usr/lib/systemd/hwdb/hwdb.bin",
+	"/lib/systemd/hwdb/hwdb.bin",
+	"/usr/lib/udev/hwdb.bin",
+};
+
+static const char hwdb_sig[8] = { 'K', 'S', 'L', 'P', 'H', 'H', 'R', 'H' };
+
+/* Offsets in the little-endian, packed structures of the file */
+#define HDR_SIGNATURE		0
+#define HDR_FILE_SIZE		16
+#define HDR_HEADER_SIZE		24
+#define HDR_NODE_SIZE		32
+#define HDR_CHILD_SIZE		40
+#define HDR_VALUE_SIZE		48
+#define HDR_ROOT_OFF		56
+#define HDR_MIN_SIZE		80
+
+#define NODE_PREFIX_OFF		0
+#define NODE_CHILDREN_COUNT	8
+#define NODE_VALUES_COUNT	16
+#define NODE_MIN_SIZE		24
+
+#define CHILD_C			0
+#define CHILD_OFF		8
+#define CHILD_MIN_SIZE		16
+
+#define VALUE_KEY_OFF		0
+#define VALUE_VALUE_OFF		8
+#define VALUE_MIN_SIZE		16
+/* Since format v2, entries also have where the value came from */
+#define VALUE_FILENAME_OFF	16
+#define VALUE_LINE_NUMBER	24
+#define VALUE_FILE_PRIORITY	28
+#define VALUE2_SIZE		32
+
+struct hwdb_file {
+	const uint8_t *map;
+	size_t size;
+	uint64_t node_size;
+	uint64_t child_size;
+	uint64_t value_size;
+	uint64_t root_off;
+};
+
+/* One property being looked up */
+struct hwdb_search {
+	const struct hwdb_file *db;
+	const char *key;
+	const uint8_t *value;		/* best value entry so far */
+	char line[LINE_MAX];		/* the pattern below a wildcard */
+	size_t len;
+};
+
+static uint64_t le64_at(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le64toh(v);
+}
+
+static uint32_t le32_at(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le32toh(v);
+}
+
+static uint16_t le16_at(const uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le16toh(v);
+}
+
+static const char *db_string(const struct hwdb_file *db, uint64_t off)
+{
+	return (const char *)db->map + off;
+}
+
+static const uint8_t *node_child(const struct hwdb_file *db, const uint8_t *node, unsigned int i)
+{
+	return node + db->node_size + i * db->child_size;
+}
+
+static const uint8_t *node_value(const struct hwdb_file *db, const uint8_t *node, uint64_t i)
+{
+	return node + db->node_size + node[NODE_CHILDREN_COUNT] * db->child_size +
+	       i * db->value_size;
+}
+
+/* The children are sorted by their character */
+static const uint8_t *node_lookup(const struct hwdb_file *db, const uint8_t *node, uint8_t c)
+{
+	unsigned int lo = 0, hi = node[NODE_CHILDREN_COUNT], mid;
+	const uint8_t *child;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		child = node_child(db, node, mid);
+		if (child[CHILD_C] == c)
+			return db->map + le64_at(child + CHILD_OFF);
+		if (child[CHILD_C] < c)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/* Keep the value, unless one from a higher priority file or line is kept */
+static void search_add(struct hwdb_search *s, const uint8_t *value)
+{
+	const struct hwdb_file *db = s->db;
+	const uint8_t *old = s->value;
+	const char *key = db_string(db, le64_at(value + VALUE_KEY_OFF));
+	bool lower;
+
+	/* Properties start with a space, other prefixes are for the future */
+	if (key[0] != ' ' || strcmp(key + 1, s->key))
+		return;
+
+	if (old && db->value_size >= VALUE2_SIZE) {
+		/* Before v3 there's no priority, but files were added in order */
+		if (!le16_at(value + VALUE_FILE_PRIORITY))
+			lower = le64_at(value + VALUE_FILENAME_OFF) < le64_at(old + VALUE_FILENAME_OFF) ||
+				(le64_at(value + VALUE_FILENAME_OFF) == le64_at(old + VALUE_FILENAME_OFF) &&
+				 le32_at(value + VALUE_LINE_NUMBER) < le32_at(old + VALUE_LINE_NUMBER));
+		else
+			lower = le16_at(value + VALUE_FILE_PRIORITY) < le16_at(old + VALUE_FILE_PRIORITY) ||
+				(le16_at(value + VALUE_FILE_PRIORITY) == le16_at(old + VALUE_FILE_PRIORITY) &&
+				 le32_at(value + VALUE_LINE_NUMBER) < le32_at(old + VALUE_LINE_NUMBER));
+		if (lower)
+			return;
+	}
+
+	s->value = value;
+}
+
+static void search_add_node(struct hwdb_search *s, const uint8_t *node)
+{
+	uint64_t i, n = le64_at(node + NODE_VALUES_COUNT);
+
+	for (i = 0; i < n; i++)
+		search_add(s, node_value(s->db, node, i));
+}
+
+/* Match every pattern in the subtree against the rest of the modalias */
+static void search_fnmatch(struct hwdb_search *s, const uint8_t *node, size_t p, const char *search)
+{
+	const struct hwdb_file *db = s->db;
+	uint64_t prefix_off = le64_at(node + NODE_PREFIX_OFF);
+	const char *prefix = prefix_off ? db_string(db, prefix_off) + p : "";
+	size_t len = strlen(prefix);
+	unsigned int i;
+
+	if (s->len + len + 2 > sizeof(s->line))
+		return;
+	memcpy(s->line + s->len, prefix, len);
+	s->len += len;
+
+	for (i = 0; i < node[NODE_CHILDREN_COUNT]; i++) {
+		const uint8_t *child = node_child(db, node, i);
+
+		s->line[s->len++] = child[CHILD_C];
+		search_fnmatch(s, db->map + le64_at(child + CHILD_OFF), 0, search);
+		s->len--;
+	}
+
+	if (le64_at(node + NODE_VALUES_COUNT)) {
+		s->line[s->len] = '\0';
+		if (fnmatch(s->line, search, 0) == 0)
+			search_add_node(s, node);
+	}
+
+	s->len -= len;
+}
+
+const char *hwdb_file_get(const struct hwdb_file *db, const char *modalias, const char *key)
+{
+	static const char wildcards[] = "*?[";
+	struct hwdb_search s = { .db = db, .key = key };
+	const uint8_t *node = db->map + db->root_off;
+	const uint8_t *child;
+	size_t i = 0, p;
+	uint64_t prefix_off;
+	const char *prefix;
+	const char *w;
+
+	while (node) {
+		prefix_off = le64_at(node + NODE_PREFIX_OFF);
+		if (prefix_off) {
+			prefix = db_string(db, prefix_off);
+			for (p = 0; prefix[p]; p++) {
+				if (strchr(wildcards, prefix[p])) {
+					search_fnmatch(&s, node, p, modalias + i + p);
+					goto out;
+				}
+				if (prefix[p] != modalias[i + p])
+					goto out;
+			}
+			i += p;
+		}
+
+		for (w = wildcards; *w; w++) {
+			child = node_lookup(db, node, *w);
+			if (child) {
+				s.line[s.len++] = *w;
+				search_fnmatch(&s, child, 0, modalias + i);
+				s.len--;
+			}
+		}
+
+		if (modalias[i] == '\0') {
+			search_add_node(&s, node);
+			break;
+		}
+
+		node = node_lookup(db, node, modalias[i]);
+		i++;
+	}
+
+out:
+	return s.value ? db_string(db, le64_at(s.value + VALUE_VALUE_OFF)) : NULL;
+}
+
+static struct hwdb_file *hwdb_file_map(const char *path)
+{
+	struct hwdb_file *db;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < HDR_MIN_SIZE) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	db = calloc(1, sizeof(*db));
+	if (!db)
+		goto fail;
+	db->map = map;
+	db->size = st.st_size;
+	db->node_size = le64_at(db->map + HDR_NODE_SIZE);
+	db->child_size = le64_at(db->map + HDR_CHILD_SIZE);
+	db->value_size = le64_at(db->map + HDR_VALUE_SIZE);
+	db->root_off = le64_at(db->map + HDR_ROOT_OFF);
+
+	if (memcmp(db->map + HDR_SIGNATURE, hwdb_sig, sizeof(hwdb_sig)) ||
+	    le64_at(db->map + HDR_FILE_SIZE) != db->size ||
+	    le64_at(db->map + HDR_HEADER_SIZE) < HDR_MIN_SIZE ||
+	    db->node_size < NODE_MIN_SIZE || db->child_size < CHILD_MIN_SIZE ||
+	    db->value_size < VALUE_MIN_SIZE || db->root_off >= db->size)
+		goto fail;
+
+	return db;
+
+fail:
+	free(db);
+	munmap(map, st.st_size);
+	return NULL;
+}
+
+struct hwdb_file *hwdb_file_open(void)
+{
+	size_t i;
+
+	/* Only the first one found is used, like systemd does */
+	for (i = 0; i < sizeof(hwdb_paths) / sizeof(hwdb_paths[0]); i++) {
+		if (access(hwdb_paths[i], F_OK) == 0)
+			return hwdb_file_map(hwdb_paths[i]);
+	}
+
+	return NULL;
+}
+
+void hwdb_file_close(struct hwdb_file *db)
+{
+	if (!db)
+		return;
+	munmap((void *)db->map, db->size);
+	free(db);
+}
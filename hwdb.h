@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Direct reader for the systemd hardware database, hwdb.bin
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef _HWDB_H
+#define _HWDB_H
+/* ---------------------------------------------------------------------- */
+
+struct hwdb_file;
+
+/*
+ * Map the first hwdb.bin found where systemd looks for it, or return NULL
+ * if there is none, or it's not in a format known here.
+ */
+extern struct hwdb_file *hwdb_file_open(void);
+extern void hwdb_file_close(struct hwdb_file *db);
+
+/*
+ * Return the value of a property for a modalias, resolved the same way
+ * sd-hwdb does, or NULL if there is none.  The value points into the
+ * mapped file, and stays valid until the file is closed.
+ */
+extern const char *hwdb_file_get(const struct hwdb_file *db, const char *modalias,
+				 const char *key);
+
+/* ---------------------------------------------------------------------- */
+#endif /* _HWDB_H */
@@ -16,6 +16,7 @@
 #include "ccan/list/list.h"
 #include "lsusb.h"
 #include "names.h"
+#include "sysfs.h"
 
 #define MY_SYSFS_FILENAME_LEN 255
 #define MY_PATH_MAX 4096
@@ -95,13 +96,18 @@ struct usbbusnode {
 	char driver[MY_SYSFS_FILENAME_LEN];
 };
 
-#define SYSFS_INTu(de,tgt, name) do { tgt->name = read_sysfs_file_int(de,#name,10); } while(0)
-#define SYSFS_INTx(de,tgt, name) do { tgt->name = read_sysfs_file_int(de,#name,16); } while(0)
-#define SYSFS_STR(de,tgt, name) do { read_sysfs_file_string(de, #name, tgt->name, MY_PARAM_MAX); } while(0)
+/*
+ * Attributes are only queued while walking the bus; they are all read in
+ * one go by sysfs_batch_run() before the tree gets connected.
+ */
+#define SYSFS_INTu(de,tgt, name) do { sysfs_batch_add(batch, de, #name, NULL, 0, sysfs_int_dec, &tgt->name); } while(0)
+#define SYSFS_INTx(de,tgt, name) do { sysfs_batch_add(batch, de, #name, NULL, 0, sysfs_int_hex, &tgt->name); } while(0)
+#define SYSFS_STR(de,tgt, name) do { sysfs_batch_add(batch, de, #name, tgt->name, MY_PARAM_MAX, sysfs_string, NULL); } while(0)
 
 static LIST_HEAD(interfacelist);
 static LIST_HEAD(usbdevlist);
 static struct usbbusnode *usbbuslist;
+static struct sysfs_batch *batch;
 
 static const char sys_bus_usb_devices[] = "/sys/bus/usb/devices";
 static int indent;
@@ -220,61 +226,41 @@ static void print_usbdevice(struct usbdevice *d, struct usbinterface *i)
 	}
 }
 
-static unsigned int read_sysfs_file_int(const char *d_name, const char *file, int base)
-{
-	char buf[12], path[MY_PATH_MAX];
-	int fd;
-	ssize_t r;
-	unsigned long ret;
-	snprintf(path, MY_PATH_MAX, "%s/%s/%s", sys_bus_usb_devices, d_name, file);
-	path[MY_PATH_MAX - 1] = '\0';
-	fd = open(path, O_RDONLY);
-	if (fd < 0)
-		goto error;
-	memset(buf, 0, sizeof(buf));
-	r = read(fd, buf, sizeof(buf) - 1);
-	close(fd);
-	if (r < 0)
-		goto error;
-	buf[sizeof(buf) - 1] = '\0';
-	ret = strtoul(buf, NULL, base);
-	return (unsigned int)ret;
-
-      error:
-	perror(path);
-	return 0;
-}
-
-static void read_sysfs_file_string(const char *d_name, const char *file, char *buf, int len)
-{
-	char path[MY_PATH_MAX];
-	int fd;
-	ssize_t r;
-	fd = snprintf(path, MY_PATH_MAX, "%s/%s/%s", sys_bus_usb_devices, d_name, file);
-	if (fd < 0 || fd >= MY_PATH_MAX)
-		goto error;
-	path[fd] = '\0';
-	fd = open(path, O_RDONLY);
-	if (fd < 0)
-		goto error;
-	r = read(fd, buf, len - 1);
-	close(fd);
-	if (r > 0) {
+static void sysfs_int(const char *path, const char *buf, int len, void *data, int base)
+{
+	unsigned int *tgt = data;
+
+	if (len < 0) {
+		fprintf(stderr, "%s/%s: %s\n", sys_bus_usb_devices, path, strerror(-len));
+		*tgt = 0;
+		return;
+	}
+	*tgt = (unsigned int)strtoul(buf, NULL, base);
+}
+
+static void sysfs_int_dec(const char *path, char *buf, int len, void *data)
+{
+	sysfs_int(path, buf, len, data, 10);
+}
+
+static void sysfs_int_hex(const char *path, char *buf, int len, void *data)
+{
+	sysfs_int(path, buf, len, data, 16);
+}
+
+static void sysfs_string(const char *path, char *buf, int len, void *data)
+{
+	int r = len - 1;
+
+	while (r >= 0 && buf[r] == '\n') {
 		buf[r] = '\0';
 		r--;
-		while (r >= 0 && buf[r] == '\n') {
-			buf[r] = '\0';
-			r--;
-		}
-		while (r >= 0) {
-			if ((unsigned char)buf[r] < 0x20 || buf[r] == 0x7f)
-				buf[r] = ' ';
-			r--;
-		}
-		return;
 	}
-      error:
-	buf[0] = '\0';
+	while (r >= 0) {
+		if ((unsigned char)buf[r] < 0x20 || buf[r] == 0x7f)
+			buf[r] = ' ';
+		r--;
+	}
 }
 
 static void append_dev_interface(struct usbinterface *i, struct usbinterface *new)
@@ -723,6 +709,37 @@ static void print_tree_dev_children(struct usbdevice *d)
 	indent -= 4;
 }
 
+/* Look up the names all at once, so identical devices cost one lookup */
+static void resolve_names(void)
+{
+	struct usbdevice *d;
+	struct usbbusnode *b;
+	struct names_id *ids;
+	size_t n = 0;
+
+	list_for_each(&usbdevlist, d, list)
+		n++;
+	for (b = usbbuslist; b; b = b->next)
+		n++;
+	ids = malloc(n * sizeof(*ids));
+	if (!ids)
+		return;
+
+	n = 0;
+	list_for_each(&usbdevlist, d, list) {
+		ids[n].vendor = d->idVendor;
+		ids[n].product = d->idProduct;
+		n++;
+	}
+	for (b = usbbuslist; b; b = b->next) {
+		ids[n].vendor = b->idVendor;
+		ids[n].product = b->idProduct;
+		n++;
+	}
+	names_resolve(ids, n);
+	free(ids);
+}
+
 static void print_tree(void)
 {
 	struct usbbusnode *b = usbbuslist;
@@ -758,16 +775,29 @@ static void cleanup(void)
 
 int lsusb_t(void)
 {
-	DIR *sbud = opendir(sys_bus_usb_devices);
+	DIR *sbud;
+
+	batch = sysfs_batch_new();
+	if (!batch) {
+		perror("sysfs_batch_new");
+		return 1;
+	}
+
+	sbud = opendir(sys_bus_usb_devices);
 	if (sbud) {
 		walk_usb_devices(sbud);
 		closedir(sbud);
+		sysfs_batch_run(batch);
 		connect_devices();
 		sort_devices();
 		sort_busses();
+		if (verblevel >= 1)
+			resolve_names();
 		print_tree();
 		cleanup();
 	} else
 		perror(sys_bus_usb_devices);
+	sysfs_batch_free(batch);
+	batch = NULL;
 	return sbud == NULL;
 }
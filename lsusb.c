@@ -3930,13 +3930,28 @@ static void sort_device_list(libusb_device **list, ssize_t num_devs)
 	} while(!sorted);
 }
 
+static bool list_device_match(libusb_device *dev, struct libusb_device_descriptor *desc,
+			      int busnum, int devnum, int vendorid, int productid)
+{
+	uint8_t bnum = libusb_get_bus_number(dev);
+	uint8_t dnum = libusb_get_device_address(dev);
+
+	if ((busnum != -1 && busnum != bnum) ||
+	    (devnum != -1 && devnum != dnum))
+		return false;
+	libusb_get_device_descriptor(dev, desc);
+	return (vendorid == -1 || vendorid == desc->idVendor) &&
+	       (productid == -1 || productid == desc->idProduct);
+}
+
 static int list_devices(libusb_context *ctx, int busnum, int devnum, int vendorid, int productid)
 {
 	libusb_device **list;
 	struct libusb_device_descriptor desc;
+	struct names_id *ids;
 	char vendor[128], product[128];
 	int status;
-	ssize_t num_devs, i;
+	ssize_t num_devs, i, n = 0;
 
 	status = 1; /* 1 device not found, 0 device found */
 
@@ -3945,17 +3960,27 @@ static int list_devices(libusb_context *ctx, int busnum, int devnum, int vendori
 		goto error;
 
 	sort_device_list(list, num_devs);
+
+	/* Look the names up all at once, so identical devices cost one lookup */
+	ids = malloc(num_devs * sizeof(*ids));
+	if (ids) {
+		for (i = 0; i < num_devs; ++i) {
+			if (!list_device_match(list[i], &desc, busnum, devnum, vendorid, productid))
+				continue;
+			ids[n].vendor = desc.idVendor;
+			ids[n].product = desc.idProduct;
+			n++;
+		}
+		names_resolve(ids, n);
+		free(ids);
+	}
+
 	for (i = 0; i < num_devs; ++i) {
 		libusb_device *dev = list[i];
 		uint8_t bnum = libusb_get_bus_number(dev);
 		uint8_t dnum = libusb_get_device_address(dev);
 
-		if ((busnum != -1 && busnum != bnum) ||
-		    (devnum != -1 && devnum != dnum))
-			continue;
-		libusb_get_device_descriptor(dev, &desc);
-		if ((vendorid != -1 && vendorid != desc.idVendor) ||
-		    (productid != -1 && productid != desc.idProduct))
+		if (!list_device_match(dev, &desc, busnum, devnum, vendorid, productid))
 			continue;
 		status = 0;
 
@@ -10,10 +10,15 @@
 
 # Py2 compat
 from __future__ import print_function
+import bisect
 import getopt
+import hashlib
+import mmap
 import os
 import re
+import struct
 import sys
+import tempfile
 
 HUB_ICLASS = 0x09
 
@@ -43,6 +48,7 @@ blue	= "\033[0;34m"
 usbvendors = {}
 usbproducts = {}
 usbclasses = {}
+usbidx = None
 
 def colorize(num, text):
 	return cols[num] + str(text) + cols[0]
@@ -64,7 +70,7 @@ def myenum(*args):
 	enums = dict(zip(args, range(len(args))))
 	return type('MyEnum', (), enums)
 
-def parse_usb_ids():
+def parse_usb_ids(unm):
 	"Parse /usr/share/{hwdata/,misc/}usb.ids and fill usbvendors, usbproducts, usbclasses"
 	vid = 0
 	did = 0
@@ -72,9 +78,6 @@ def parse_usb_ids():
 	mode = modes.Vendor
 	strg = ""
 	cstrg = ""
-	for unm in usbids:
-		if os.path.exists(unm):
-			break
 	for ln in open_read_ign(unm).readlines():
 		if ln[0] == '#':
 			continue
@@ -117,25 +120,157 @@ def parse_usb_ids():
 		mode = modes.Misc
 	usbclasses[0xFF, 0xFF, 0xFF] = "Vendor Specific"
 
+class UsbIdsIndex:
+	"""Compact index of usb.ids, cached on disk and mmap()ed, so a run only
+	touches the few names it looks up instead of parsing the whole file.
+
+	The file is a header, then records sorted by key, each the key, and
+	the offset and length of the name in the string pool following them.
+	It's valid for the usb.ids with the path, size and mtime in the header.
+	"""
+	magic = b"USBIDX1\0"
+	header = struct.Struct("<8sqqII")	# magic, mtime_ns, size, records, path length
+	record = struct.Struct("<QII")		# key, name offset, name length
+	VENDOR, PRODUCT, CLASS = 1, 2, 3
+
+	@staticmethod
+	def key(tag, a, b=0, c=0):
+		"Sortable record key, -1 (any) encoded as 0xFFFF"
+		return tag << 48 | (a & 0xFFFF) << 32 | (b & 0xFFFF) << 16 | (c & 0xFFFF)
+
+	@staticmethod
+	def cache_path(unm):
+		"Where the index of a usb.ids lives"
+		cache = os.environ.get("XDG_CACHE_HOME") or os.path.join(os.path.expanduser("~"), ".cache")
+		digest = hashlib.sha1(os.path.abspath(unm).encode("utf-8")).hexdigest()[:16]
+		return os.path.join(cache, "usbutils", "usb.ids-%s.idx" % digest)
+
+	@staticmethod
+	def stamp(st):
+		return getattr(st, "st_mtime_ns", int(st.st_mtime * 1000000000)), st.st_size
+
+	@classmethod
+	def write(cls, fname, unm, st):
+		"Write the index of the parsed usbvendors, usbproducts, usbclasses"
+		entries = [(cls.key(cls.VENDOR, vid), name) for vid, name in usbvendors.items()]
+		entries += [(cls.key(cls.PRODUCT, vid, pid), name) for (vid, pid), name in usbproducts.items()]
+		entries += [(cls.key(cls.CLASS, cid, sid, pid), name) for (cid, sid, pid), name in usbclasses.items()]
+		entries.sort()
+		path = os.path.abspath(unm).encode("utf-8")
+		mtime, size = cls.stamp(st)
+		records = []
+		pool = []
+		offset = 0
+		for key, name in entries:
+			name = name.encode("utf-8")
+			records.append(cls.record.pack(key, offset, len(name)))
+			pool.append(name)
+			offset += len(name)
+		dname = os.path.dirname(fname)
+		if not os.path.isdir(dname):
+			os.makedirs(dname)
+		# Write a temporary file and rename it, so readers never see half of it
+		fd, tmp = tempfile.mkstemp(dir=dname)
+		try:
+			with os.fdopen(fd, "wb") as f:
+				f.write(cls.header.pack(cls.magic, mtime, size, len(records), len(path)))
+				f.write(path)
+				f.write(b"".join(records))
+				f.write(b"".join(pool))
+			os.rename(tmp, fname)
+		except:
+			os.unlink(tmp)
+			raise
+
+	@classmethod
+	def open(cls, fname, unm, st):
+		"Return the index, or None if missing, stale or corrupt"
+		try:
+			with open(fname, "rb") as f:
+				mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		except (IOError, OSError, ValueError):
+			return None
+		idx = cls(mm)
+		path = os.path.abspath(unm).encode("utf-8")
+		if idx.hdr[0] != cls.magic or idx.hdr[1:3] != cls.stamp(st) or \
+		   mm[cls.header.size:cls.header.size + idx.hdr[4]] != path or \
+		   idx.pool > len(mm):
+			mm.close()
+			return None
+		return idx
+
+	def __init__(self, mm):
+		self.mm = mm
+		self.hdr = (None,) * 5
+		if len(mm) >= self.header.size:
+			self.hdr = self.header.unpack_from(mm, 0)
+		self.count = self.hdr[3] or 0
+		self.base = self.header.size + (self.hdr[4] or 0)
+		self.pool = self.base + self.count * self.record.size
+
+	def __len__(self):
+		return self.count
+
+	def __getitem__(self, i):
+		"The key of record i, for bisecting"
+		return struct.unpack_from("<Q", self.mm, self.base + i * self.record.size)[0]
+
+	def get(self, tag, a, b=0, c=0):
+		"Return the name with the key, or None"
+		key = self.key(tag, a, b, c)
+		i = bisect.bisect_left(self, key, 0, self.count)
+		if i == self.count or self[i] != key:
+			return None
+		key, offset, length = self.record.unpack_from(self.mm, self.base + i * self.record.size)
+		offset += self.pool
+		return self.mm[offset:offset + length].decode("utf-8", "ignore")
+
+def load_usb_ids():
+	"Use the cached usb.ids index, rebuilding it if stale, or else the parsed usb.ids"
+	global usbidx
+	for unm in usbids:
+		if os.path.exists(unm):
+			break
+	st = os.stat(unm)
+	fname = UsbIdsIndex.cache_path(unm)
+	usbidx = UsbIdsIndex.open(fname, unm, st)
+	if usbidx is not None:
+		return
+	parse_usb_ids(unm)
+	try:
+		UsbIdsIndex.write(fname, unm, st)
+	except (IOError, OSError):
+		# Not cacheable, e.g. read-only home; just use what was parsed
+		pass
+
 def find_usb_prod(vid, pid):
 	"Return device name from USB Vendor:Product list"
 	strg = ""
-	vendor = usbvendors.get(vid)
+	if usbidx is not None:
+		vendor = usbidx.get(UsbIdsIndex.VENDOR, vid)
+	else:
+		vendor = usbvendors.get(vid)
 	if vendor:
 		strg = str(vendor)
 	else:
 		return ""
-	product = usbproducts.get((vid, pid))
+	if usbidx is not None:
+		product = usbidx.get(UsbIdsIndex.PRODUCT, vid, pid)
+	else:
+		product = usbproducts.get((vid, pid))
 	if product:
 		return strg + " " + str(product)
 	return strg
 
 def find_usb_class(cid, sid, pid):
 	"Return USB protocol from usbclasses list"
-	lnlst = len(usbclasses)
-	cls = usbclasses.get((cid, sid, pid)) \
-		or usbclasses.get((cid, sid, -1)) \
-		or usbclasses.get((cid, -1, -1))
+	if usbidx is not None:
+		get = lambda c, s, p: usbidx.get(UsbIdsIndex.CLASS, c, s, p)
+	else:
+		get = lambda c, s, p: usbclasses.get((c, s, p))
+	cls = get(cid, sid, pid) \
+		or get(cid, sid, -1) \
+		or get(cid, -1, -1)
 	if cls:
 		return str(cls)
 	return ""
@@ -546,7 +681,7 @@ def main(argv):
 
 	if usbids[0]:
 		try:
-			parse_usb_ids()
+			load_usb_ids()
 		except:
 			print(" WARNING: Failure to read usb.ids", file=sys.stderr)
 			#print(sys.exc_info(), file=sys.stderr)
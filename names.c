@@ -23,12 +23,46 @@
 #include "usb-spec.h"
 #include "names.h"
 #include "sysfs.h"
+#include "hwdb.h"
+#ifdef HAVE_USB_IDS
+#include "usb-ids.h"
+#define usb_ids_get(table, key) usb_ids_find(usb_ids_##table, usb_ids_n##table, key)
+#else
+#define usb_ids_get(table, key) NULL
+#endif
 
 
 /* ---------------------------------------------------------------------- */
 
+static struct hwdb_file *hwdb_file = NULL;
 static struct udev *udev = NULL;
 static struct udev_hwdb *hwdb = NULL;
+static bool use_usb_ids = false;
+
+enum class_kind {
+	KIND_CLASS = 1,
+	KIND_SUBCLASS,
+	KIND_PROTOCOL,
+};
+
+/* Vendors and products are cached next to classes, packed as for usb.ids */
+#define CACHE_VENDOR	(1ULL << 32)
+#define CACHE_PRODUCT	(2ULL << 32)
+
+/*
+ * Every name is looked up in the hwdb once and kept here, found or not.
+ * Class lookups can't be narrowed down by the trie, they go through all
+ * of usb:v*p*d*, and the same devices come up again and again.  The keys
+ * are sparse, so it's a hash of them, grown as needed.  Names from
+ * libudev are copied, as they only last until its next query, so all
+ * the names returned stay valid until names_exit().
+ */
+static struct cached_name {
+	uint64_t key;		/* 0 if unused */
+	const char *name;
+} *name_cache = NULL;
+static size_t name_cache_size = 0;
+static size_t name_cache_used = 0;
 
 /* ---------------------------------------------------------------------- */
 
@@ -81,10 +115,31 @@ const char *names_countrycode(unsigned int countrycode)
 	return names_genericstrtable(countrycodes, countrycode);
 }
 
+#ifdef HAVE_USB_IDS
+static const char *usb_ids_find(const struct usb_ids_entry *t, size_t n, uint32_t key)
+{
+	size_t lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (t[mid].key == key)
+			return usb_ids_strings + t[mid].name;
+		if (t[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+#endif
+
 static const char *hwdb_get(const char *modalias, const char *key)
 {
 	struct udev_list_entry *entry;
 
+	if (hwdb_file)
+		return hwdb_file_get(hwdb_file, modalias, key);
+
 	udev_list_entry_foreach(entry, udev_hwdb_get_properties_list_entry(hwdb, modalias, 0))
 		if (strcmp(udev_list_entry_get_name(entry), key) == 0)
 			return udev_list_entry_get_value(entry);
@@ -92,44 +147,184 @@ static const char *hwdb_get(const char *modalias, const char *key)
 	return NULL;
 }
 
+static struct cached_name *name_cache_slot(uint64_t key)
+{
+	uint64_t h = key * 0x9e3779b97f4a7c15ULL;
+	size_t i;
+
+	h ^= h >> 32;
+	for (i = h & (name_cache_size - 1); name_cache[i].key && name_cache[i].key != key;
+	     i = (i + 1) & (name_cache_size - 1))
+		;
+	return &name_cache[i];
+}
+
+static bool name_cache_grow(void)
+{
+	struct cached_name *old = name_cache;
+	size_t i, size = name_cache_size;
+
+	name_cache_size = size ? size * 2 : 64;
+	name_cache = calloc(name_cache_size, sizeof(*name_cache));
+	if (!name_cache) {
+		name_cache = old;
+		name_cache_size = size;
+		return false;
+	}
+	for (i = 0; i < size; i++)
+		if (old[i].key)
+			*name_cache_slot(old[i].key) = old[i];
+	free(old);
+	return true;
+}
+
+static bool name_cache_find(uint64_t key, const char **name)
+{
+	struct cached_name *slot;
+
+	if (!name_cache_used)
+		return false;
+	slot = name_cache_slot(key);
+	if (!slot->key)
+		return false;
+	*name = slot->name;
+	return true;
+}
+
+/* Return the name as kept in the cache, if there's room for it */
+static const char *name_cache_add(uint64_t key, const char *name)
+{
+	struct cached_name *slot;
+	char *copy;
+
+	if ((name_cache_used + 1) * 2 > name_cache_size && !name_cache_grow())
+		return name;
+	if (name && !hwdb_file) {
+		copy = strdup(name);
+		if (!copy)
+			return name;
+		name = copy;
+	}
+	slot = name_cache_slot(key);
+	slot->key = key;
+	slot->name = name;
+	name_cache_used++;
+	return name;
+}
+
+static const char *hwdb_get_class(enum class_kind kind, uint8_t cls, uint8_t subcls,
+				  uint8_t proto)
+{
+	static const char *const keys[] = {
+		[KIND_CLASS] = "ID_USB_CLASS_FROM_DATABASE",
+		[KIND_SUBCLASS] = "ID_USB_SUBCLASS_FROM_DATABASE",
+		[KIND_PROTOCOL] = "ID_USB_PROTOCOL_FROM_DATABASE",
+	};
+	uint32_t key = (uint32_t)kind << 24 | cls << 16 | subcls << 8 | proto;
+	char modalias[64];
+	const char *name;
+
+	if (use_usb_ids)
+		return usb_ids_get(classes, key);
+	if (name_cache_find(key, &name))
+		return name;
+
+	switch (kind) {
+	case KIND_CLASS:
+		snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02X*", cls);
+		break;
+	case KIND_SUBCLASS:
+		snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02Xdsc%02X*", cls, subcls);
+		break;
+	case KIND_PROTOCOL:
+		snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02Xdsc%02Xdp%02X*", cls, subcls, proto);
+		break;
+	}
+	return name_cache_add(key, hwdb_get(modalias, keys[kind]));
+}
+
 const char *names_vendor(uint16_t vendorid)
 {
+	uint64_t key = CACHE_VENDOR | vendorid;
 	char modalias[64];
+	const char *name;
 
+	if (use_usb_ids)
+		return usb_ids_get(vendors, vendorid);
+	if (name_cache_find(key, &name))
+		return name;
 	snprintf(modalias, sizeof(modalias), "usb:v%04X*", vendorid);
-	return hwdb_get(modalias, "ID_VENDOR_FROM_DATABASE");
+	return name_cache_add(key, hwdb_get(modalias, "ID_VENDOR_FROM_DATABASE"));
 }
 
 const char *names_product(uint16_t vendorid, uint16_t productid)
 {
+	uint32_t id = (uint32_t)vendorid << 16 | productid;
+	uint64_t key = CACHE_PRODUCT | id;
 	char modalias[64];
+	const char *name;
 
+	if (use_usb_ids)
+		return usb_ids_get(products, id);
+	if (name_cache_find(key, &name))
+		return name;
 	snprintf(modalias, sizeof(modalias), "usb:v%04Xp%04X*", vendorid, productid);
-	return hwdb_get(modalias, "ID_MODEL_FROM_DATABASE");
+	return name_cache_add(key, hwdb_get(modalias, "ID_MODEL_FROM_DATABASE"));
 }
 
-const char *names_class(uint8_t classid)
+static int names_id_cmp(const void *a, const void *b)
 {
-	char modalias[64];
+	const struct names_id *x = a, *y = b;
 
-	snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02X*", classid);
-	return hwdb_get(modalias, "ID_USB_CLASS_FROM_DATABASE");
+	if (x->vendor != y->vendor)
+		return x->vendor < y->vendor ? -1 : 1;
+	if (x->product != y->product)
+		return x->product < y->product ? -1 : 1;
+	return 0;
 }
 
-const char *names_subclass(uint8_t classid, uint8_t subclassid)
+void names_resolve(const struct names_id *ids, size_t count)
 {
-	char modalias[64];
+	struct names_id *sorted;
+	size_t i;
+
+	if (use_usb_ids || count == 0)
+		return;
 
-	snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02Xdsc%02X*", classid, subclassid);
-	return hwdb_get(modalias, "ID_USB_SUBCLASS_FROM_DATABASE");
+	/*
+	 * Look every vendor and product up once, in order, so identical
+	 * devices cost one lookup, and the hwdb is walked front to back.
+	 */
+	sorted = malloc(count * sizeof(*sorted));
+	if (!sorted)
+		return;
+	memcpy(sorted, ids, count * sizeof(*sorted));
+	qsort(sorted, count, sizeof(*sorted), names_id_cmp);
+
+	for (i = 0; i < count; i++) {
+		if (i && names_id_cmp(&sorted[i - 1], &sorted[i]) == 0)
+			continue;
+		if (!i || sorted[i - 1].vendor != sorted[i].vendor)
+			names_vendor(sorted[i].vendor);
+		names_product(sorted[i].vendor, sorted[i].product);
+	}
+
+	free(sorted);
 }
 
-const char *names_protocol(uint8_t classid, uint8_t subclassid, uint8_t protocolid)
+const char *names_class(uint8_t classid)
 {
-	char modalias[64];
+	return hwdb_get_class(KIND_CLASS, classid, 0, 0);
+}
 
-	snprintf(modalias, sizeof(modalias), "usb:v*p*d*dc%02Xdsc%02Xdp%02X*", classid, subclassid, protocolid);
-	return hwdb_get(modalias, "ID_USB_PROTOCOL_FROM_DATABASE");
+const char *names_subclass(uint8_t classid, uint8_t subclassid)
+{
+	return hwdb_get_class(KIND_SUBCLASS, classid, subclassid, 0);
+}
+
+const char *names_protocol(uint8_t classid, uint8_t subclassid, uint8_t protocolid)
+{
+	return hwdb_get_class(KIND_PROTOCOL, classid, subclassid, protocolid);
 }
 
 const char *names_audioterminal(uint16_t termt)
@@ -238,16 +433,49 @@ void get_vendor_product_with_fallback(char *vendor, int vendor_len,
 
 int names_init(void)
 {
+#ifdef HAVE_USB_IDS
+	const char *db = getenv("USBUTILS_NAMES");
+
+	/* The built-in names don't change with the system, e.g. for tests */
+	if (db && strcmp(db, "builtin") == 0) {
+		use_usb_ids = true;
+		return 0;
+	}
+#endif
+
+	/* Read hwdb.bin directly where possible, it's much faster */
+	hwdb_file = hwdb_file_open();
+	if (hwdb_file)
+		return 0;
+
 	udev = udev_new();
-	if (!udev)
-		return -1;
+	if (udev)
+		hwdb = udev_hwdb_new(udev);
+	if (hwdb)
+		return 0;
 
-	hwdb = udev_hwdb_new(udev);
-	return hwdb ? 0 : -1;
+#ifdef HAVE_USB_IDS
+	use_usb_ids = true;
+	return 0;
+#else
+	return -1;
+#endif
 }
 
 void names_exit(void)
 {
+	size_t i;
+
+	if (!hwdb_file)
+		for (i = 0; i < name_cache_size; i++)
+			free((char *)name_cache[i].name);
+	free(name_cache);
+	name_cache = NULL;
+	name_cache_size = name_cache_used = 0;
+
+	hwdb_file_close(hwdb_file);
+	hwdb_file = NULL;
 	hwdb = udev_hwdb_unref(hwdb);
 	udev = udev_unref(udev);
+	use_usb_ids = false;
 }
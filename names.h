@@ -10,6 +10,17 @@
 
 /* ---------------------------------------------------------------------- */
 
+struct names_id {
+	uint16_t vendor;
+	uint16_t product;
+};
+
+/*
+ * All the names returned stay valid until names_exit().  names_resolve()
+ * looks up the names of many devices at once, after which names_vendor()
+ * and names_product() return them from memory.
+ */
+extern void names_resolve(const struct names_id *ids, size_t count);
 extern const char *names_vendor(uint16_t vendorid);
 extern const char *names_product(uint16_t vendorid, uint16_t productid);
 extern const char *names_class(uint8_t classid);
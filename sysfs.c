@@ -8,13 +8,19 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <linux/limits.h>
 
 #include <libusb.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 #include "sysfs.h"
 
@@ -24,7 +30,8 @@
  */
 #define USB_MAX_DEPTH 7
 
-#define SYSFS_DEV_ATTR_PATH "/sys/bus/usb/devices/%s/%s"
+#define SYSFS_DEV_DIR "/sys/bus/usb/devices"
+#define SYSFS_DEV_ATTR_PATH SYSFS_DEV_DIR "/%s/%s"
 
 int get_sysfs_name(char *buf, size_t size, libusb_device *dev)
 {
@@ -83,3 +90,300 @@ int read_sysfs_prop(char *buf, size_t size, const char *sysfs_name, const char *
 	close(fd);
 	return n;
 }
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Batched attribute reader.
+ *
+ * Walking the whole bus with one blocking open/read/close per attribute is
+ * dominated by syscall latency on hosts with many devices.  Callers queue
+ * every attribute they need up front and then complete them all at once.
+ * When built with liburing the opens, reads and closes are handed to
+ * io_uring in large batches; otherwise, or if io_uring can not be set up
+ * at runtime, plain openat()/read() relative to a single directory fd are
+ * used.
+ */
+
+#define SYSFS_BATCH_RING_SIZE	256
+
+struct sysfs_batch_entry {
+	char path[NAME_MAX + 64];	/* relative to SYSFS_DEV_DIR */
+	char *buf;			/* NULL for small, see entry_buf() */
+	size_t size;
+	char small[24];			/* used when the caller passes no buffer */
+	int fd;
+	int len;
+	sysfs_batch_cb cb;
+	void *data;
+};
+
+struct sysfs_batch {
+	struct sysfs_batch_entry *entries;
+	size_t num;
+	size_t alloc;
+};
+
+/*
+ * The entries move when the array grows, so a pointer to their own small
+ * buffer can only be taken once all of them have been added.
+ */
+static char *entry_buf(struct sysfs_batch_entry *e)
+{
+	return e->buf ? e->buf : e->small;
+}
+
+struct sysfs_batch *sysfs_batch_new(void)
+{
+	return calloc(1, sizeof(struct sysfs_batch));
+}
+
+void sysfs_batch_free(struct sysfs_batch *b)
+{
+	if (!b)
+		return;
+	free(b->entries);
+	free(b);
+}
+
+int sysfs_batch_add(struct sysfs_batch *b, const char *sysfs_name,
+		    const char *propname, char *buf, size_t size,
+		    sysfs_batch_cb cb, void *data)
+{
+	static char empty[1];
+	struct sysfs_batch_entry *e;
+	char path[sizeof(e->path)];
+	int err = -ENOMEM;
+	int n;
+
+	if (b->num == b->alloc) {
+		size_t alloc = b->alloc ? b->alloc * 2 : 64;
+
+		e = realloc(b->entries, alloc * sizeof(*e));
+		if (!e)
+			goto error;
+		b->entries = e;
+		b->alloc = alloc;
+	}
+
+	e = &b->entries[b->num];
+	n = snprintf(e->path, sizeof(e->path), "%s/%s", sysfs_name, propname);
+	if (n < 0 || (size_t)n >= sizeof(e->path)) {
+		err = -ENAMETOOLONG;
+		goto error;
+	}
+	if (buf) {
+		e->buf = buf;
+		e->size = size;
+	} else {
+		e->buf = NULL;
+		e->size = sizeof(e->small);
+	}
+	e->fd = -1;
+	e->len = -EIO;
+	e->cb = cb;
+	e->data = data;
+	b->num++;
+	return 0;
+
+error:
+	/* Report the failure straight away so callers need no error path */
+	if (buf && size)
+		buf[0] = '\0';
+	/* Same path as on success, truncated if it's too long */
+	if (snprintf(path, sizeof(path), "%s/%s", sysfs_name, propname) < 0)
+		path[0] = '\0';
+	cb(path, buf ? buf : empty, err, data);
+	return -1;
+}
+
+static void sysfs_batch_read_sync(struct sysfs_batch_entry *e, int dirfd)
+{
+	ssize_t r;
+
+	e->fd = openat(dirfd, e->path, O_RDONLY | O_CLOEXEC);
+	if (e->fd < 0) {
+		e->len = -errno;
+		return;
+	}
+	r = read(e->fd, entry_buf(e), e->size - 1);
+	e->len = r < 0 ? -errno : r;
+	close(e->fd);
+	e->fd = -1;
+}
+
+static void sysfs_batch_run_sync(struct sysfs_batch *b, int dirfd)
+{
+	struct sysfs_batch_entry *e;
+
+	for (e = b->entries; e < b->entries + b->num; e++)
+		sysfs_batch_read_sync(e, dirfd);
+}
+
+#ifdef HAVE_LIBURING
+enum sysfs_batch_op {
+	SYSFS_BATCH_OPEN,
+	SYSFS_BATCH_READ,
+	SYSFS_BATCH_CLOSE,
+};
+
+/* Queue one operation for every entry in the chunk and reap them all */
+static int sysfs_batch_uring_pass(struct io_uring *ring, int dirfd,
+				  struct sysfs_batch_entry *chunk, size_t n,
+				  enum sysfs_batch_op op)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	struct sysfs_batch_entry *e;
+	unsigned int queued = 0;
+	unsigned int submitted;
+	int ret;
+
+	for (e = chunk; e < chunk + n; e++) {
+		if (op != SYSFS_BATCH_OPEN && e->fd < 0)
+			continue;
+		sqe = io_uring_get_sqe(ring);
+		if (!sqe)
+			break;
+		switch (op) {
+		case SYSFS_BATCH_OPEN:
+			io_uring_prep_openat(sqe, dirfd, e->path,
+					     O_RDONLY | O_CLOEXEC, 0);
+			break;
+		case SYSFS_BATCH_READ:
+			io_uring_prep_read(sqe, e->fd, entry_buf(e), e->size - 1, 0);
+			break;
+		case SYSFS_BATCH_CLOSE:
+			io_uring_prep_close(sqe, e->fd);
+			break;
+		}
+		io_uring_sqe_set_data(sqe, e);
+		queued++;
+	}
+	if (!queued)
+		return 0;
+
+	/*
+	 * Only wait for what was actually submitted.  Whatever wasn't is
+	 * dropped with the ring, and the entries are left for the sync retry.
+	 */
+	ret = io_uring_submit(ring);
+	if (ret < 0)
+		return ret;
+	submitted = ret;
+
+	while (submitted) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret == -EINTR)
+			continue;
+		if (ret < 0)
+			return ret;
+		e = io_uring_cqe_get_data(cqe);
+		switch (op) {
+		case SYSFS_BATCH_OPEN:
+			e->fd = cqe->res;
+			if (cqe->res < 0)
+				e->len = cqe->res;
+			break;
+		case SYSFS_BATCH_READ:
+			e->len = cqe->res;
+			break;
+		case SYSFS_BATCH_CLOSE:
+			e->fd = -1;
+			break;
+		}
+		io_uring_cqe_seen(ring, cqe);
+		submitted--;
+		queued--;
+	}
+	/* A short submit leaves the ring in an unknown state, give up on it */
+	return queued ? -EAGAIN : 0;
+}
+
+/* Rings set up fine on kernels that can't open, read or close with them */
+static bool sysfs_batch_uring_usable(struct io_uring *ring)
+{
+	struct io_uring_probe *probe;
+	bool usable;
+
+	probe = io_uring_get_probe_ring(ring);
+	if (!probe)
+		return false;
+	usable = io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+		 io_uring_opcode_supported(probe, IORING_OP_READ) &&
+		 io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+	io_uring_free_probe(probe);
+	return usable;
+}
+
+static int sysfs_batch_run_uring(struct sysfs_batch *b, int dirfd)
+{
+	struct sysfs_batch_entry *e;
+	struct io_uring ring;
+	size_t i, n;
+	int ret = 0;
+
+	/* ENOSYS, EPERM (seccomp, io_uring_disabled) etc. mean "fall back" */
+	if (io_uring_queue_init(SYSFS_BATCH_RING_SIZE, &ring, 0) < 0)
+		return -1;
+	if (!sysfs_batch_uring_usable(&ring)) {
+		io_uring_queue_exit(&ring);
+		return -1;
+	}
+
+	for (i = 0; i < b->num && ret == 0; i += n) {
+		n = b->num - i;
+		if (n > SYSFS_BATCH_RING_SIZE)
+			n = SYSFS_BATCH_RING_SIZE;
+		ret = sysfs_batch_uring_pass(&ring, dirfd, b->entries + i, n,
+					     SYSFS_BATCH_OPEN);
+		if (ret == 0)
+			ret = sysfs_batch_uring_pass(&ring, dirfd, b->entries + i,
+						     n, SYSFS_BATCH_READ);
+		if (ret == 0)
+			ret = sysfs_batch_uring_pass(&ring, dirfd, b->entries + i,
+						     n, SYSFS_BATCH_CLOSE);
+	}
+
+	io_uring_queue_exit(&ring);
+
+	/*
+	 * Don't leak descriptors if the ring broke half way through, and
+	 * redo whatever it didn't get to, or failed in ways the plain system
+	 * calls might not.
+	 */
+	for (e = b->entries; e < b->entries + b->num; e++) {
+		if (e->fd >= 0) {
+			close(e->fd);
+			e->fd = -1;
+		}
+		if (e->len == -EIO || e->len == -EINVAL || e->len == -EOPNOTSUPP)
+			sysfs_batch_read_sync(e, dirfd);
+	}
+	return 0;
+}
+#endif
+
+void sysfs_batch_run(struct sysfs_batch *b)
+{
+	struct sysfs_batch_entry *e;
+	int dirfd;
+
+	dirfd = open(SYSFS_DEV_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd >= 0) {
+#ifdef HAVE_LIBURING
+		if (sysfs_batch_run_uring(b, dirfd) < 0)
+#endif
+			sysfs_batch_run_sync(b, dirfd);
+		close(dirfd);
+	} else {
+		for (e = b->entries; e < b->entries + b->num; e++)
+			e->len = -errno;
+	}
+
+	for (e = b->entries; e < b->entries + b->num; e++) {
+		entry_buf(e)[e->len > 0 ? e->len : 0] = '\0';
+		e->cb(e->path, entry_buf(e), e->len, e->data);
+	}
+	b->num = 0;
+}
@@ -12,5 +12,22 @@
 int get_sysfs_name(char *buf, size_t size, libusb_device *dev);
 extern int read_sysfs_prop(char *buf, size_t size, const char *sysfs_name, const char *propname);
 
+/*
+ * Batched attribute reads: queue with sysfs_batch_add(), then complete all
+ * of them with sysfs_batch_run().  The callback gets the attribute path
+ * relative to /sys/bus/usb/devices, the NUL terminated contents and the
+ * number of bytes read, or a negative errno value on failure.  If buf is
+ * NULL a small internal buffer suitable for numeric attributes is used.
+ */
+struct sysfs_batch;
+typedef void (*sysfs_batch_cb)(const char *path, char *buf, int len, void *data);
+
+extern struct sysfs_batch *sysfs_batch_new(void);
+extern int sysfs_batch_add(struct sysfs_batch *b, const char *sysfs_name,
+			   const char *propname, char *buf, size_t size,
+			   sysfs_batch_cb cb, void *data);
+extern void sysfs_batch_run(struct sysfs_batch *b);
+extern void sysfs_batch_free(struct sysfs_batch *b);
+
 /* ---------------------------------------------------------------------- */
 #endif /* _SYSFS_H */
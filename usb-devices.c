@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usb-devices - print USB device details
+ *
+ * A C version of the usb-devices shell script, printing exactly the same.
+ * The bus is walked first, with one directory fd per device to list its
+ * interfaces and children, queueing every attribute to print; then all of
+ * them are read in a single sysfs batch, and printed.
+ *
+ * Copyright (c) 2009 Greg Kroah-Hartman <greg@kroah.com>
+ * Copyright (c) 2009 Randy Dunlap <rdunlap@xenotime.net>
+ * Copyright (c) 2009 Frans Pop <elendil@planet.nl>
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include <libusb.h>
+#include "sysfs.h"
+
+#define SYSFS_DEV_DIR	"/sys/bus/usb/devices"
+
+/* Plenty for any numeric attribute, and for the longest string descriptor */
+#define ATTR_LEN	32
+#define STRING_LEN	512
+
+struct attr {
+	int len;		/* bytes read, or a negative errno */
+	char buf[ATTR_LEN];
+};
+
+struct string_attr {
+	int len;
+	char buf[STRING_LEN];
+};
+
+enum {
+	EP_ADDRESS,
+	EP_ATTRIBUTES,
+	EP_DIRECTION,
+	EP_TYPE,
+	EP_MAXPS,
+	EP_INTERVAL,
+	EP_ATTR_NUM,
+};
+
+static const char *const ep_attr_names[EP_ATTR_NUM] = {
+	"bEndpointAddress", "bmAttributes", "direction", "type", "wMaxPacketSize", "interval",
+};
+
+enum {
+	IF_NUMBER,
+	IF_ALTSETTING,
+	IF_NUM_EPS,
+	IF_CLASS,
+	IF_SUBCLASS,
+	IF_PROTOCOL,
+	IF_ATTR_NUM,
+};
+
+static const char *const if_attr_names[IF_ATTR_NUM] = {
+	"bInterfaceNumber", "bAlternateSetting", "bNumEndpoints",
+	"bInterfaceClass", "bInterfaceSubClass", "bInterfaceProtocol",
+};
+
+enum {
+	DEV_BUSNUM,
+	DEV_DEVNUM,
+	DEV_SPEED,
+	DEV_MAXCHILD,
+	DEV_VERSION,
+	DEV_CLASS,
+	DEV_SUBCLASS,
+	DEV_PROTOCOL,
+	DEV_MAXPS0,
+	DEV_NUM_CONFIGS,
+	DEV_VENDOR,
+	DEV_PRODUCT,
+	DEV_BCD,
+	DEV_NUM_IFS,
+	DEV_CONFIG,
+	DEV_ATTRIBUTES,
+	DEV_MAXPOWER,
+	DEV_ATTR_NUM,
+};
+
+static const char *const dev_attr_names[DEV_ATTR_NUM] = {
+	"busnum", "devnum", "speed", "maxchild", "version",
+	"bDeviceClass", "bDeviceSubClass", "bDeviceProtocol", "bMaxPacketSize0",
+	"bNumConfigurations", "idVendor", "idProduct", "bcdDevice",
+	"bNumInterfaces", "bConfigurationValue", "bmAttributes", "bMaxPower",
+};
+
+enum {
+	STR_MANUFACTURER,
+	STR_PRODUCT,
+	STR_SERIAL,
+	STR_NUM,
+};
+
+static const char *const str_attr_names[STR_NUM] = { "manufacturer", "product", "serial" };
+static const char *const str_labels[STR_NUM] = { "Manufacturer", "Product", "SerialNumber" };
+
+struct endpoint {
+	struct attr attr[EP_ATTR_NUM];
+};
+
+struct interface {
+	char driver[NAME_MAX + 1];
+	struct attr attr[IF_ATTR_NUM];
+	struct endpoint *eps;
+	int num_eps;
+};
+
+/* A device, in the order printed: each followed by its children */
+struct device {
+	int level;
+	int parent;		/* index of the parent device, or -1 */
+	int port;
+	int count;		/* number among the parent's children */
+	struct attr attr[DEV_ATTR_NUM];
+	struct string_attr str[STR_NUM];
+	struct interface *ifs;
+	int num_ifs;
+};
+
+static struct device **devices;
+static int num_devices, alloc_devices;
+static struct sysfs_batch *batch;
+
+static void store_len(const char *path, char *buf, int len, void *data)
+{
+	*(int *)data = len;
+}
+
+static void queue_attr(const char *name, const char *attr, struct attr *a)
+{
+	a->len = -ENOENT;
+	sysfs_batch_add(batch, name, attr, a->buf, sizeof(a->buf), store_len, &a->len);
+}
+
+/* Like the shell's read -r: the first line, without surrounding blanks */
+static const char *value(struct attr *a)
+{
+	char *p = a->buf, *end;
+
+	if (a->len < 0)
+		return "";
+
+	end = strchr(p, '\n');
+	if (end)
+		*end = '\0';
+	while (*p == ' ' || *p == '\t')
+		p++;
+	end = p + strlen(p);
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+		*--end = '\0';
+
+	return p;
+}
+
+/* The shell's printf %i of a value */
+static long number(struct attr *a)
+{
+	return strtol(value(a), NULL, 0);
+}
+
+/* The bInterfaceNumber and bNumEndpoints hex bytes, as "0x${ifnum#0}" */
+static long hex_number(struct attr *a)
+{
+	const char *v = value(a);
+
+	return strtol(v[0] == '0' ? v + 1 : v, NULL, 16);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* List the names in a directory matching a glob, in the shell's glob order */
+static int list_dir(int dfd, const char *pattern, char ***names)
+{
+	struct dirent *ent;
+	char **list = NULL, **tmp;
+	int n = 0, alloc = 0;
+	DIR *dir;
+
+	*names = NULL;
+	dfd = dup(dfd);
+	if (dfd < 0)
+		return 0;
+	dir = fdopendir(dfd);
+	if (!dir) {
+		close(dfd);
+		return 0;
+	}
+	/* The duplicate shares the position with any previous listing */
+	rewinddir(dir);
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (fnmatch(pattern, ent->d_name, FNM_PERIOD))
+			continue;
+		if (n == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			tmp = realloc(list, alloc * sizeof(*list));
+			if (!tmp)
+				break;
+			list = tmp;
+		}
+		list[n] = strdup(ent->d_name);
+		if (list[n])
+			n++;
+	}
+	closedir(dir);
+
+	qsort(list, n, sizeof(*list), compare_names);
+	*names = list;
+	return n;
+}
+
+static void free_names(char **names, int n)
+{
+	while (n > 0)
+		free(names[--n]);
+	free(names);
+}
+
+static void walk_interface(int dfd, const char *name, struct interface *intf)
+{
+	char link[PATH_MAX], path[NAME_MAX + 16], **eps;
+	const char *driver;
+	struct stat st;
+	ssize_t len;
+	int i, ifd;
+
+	for (i = 0; i < IF_ATTR_NUM; i++)
+		queue_attr(name, if_attr_names[i], &intf->attr[i]);
+
+	strcpy(intf->driver, "(none)");
+	ifd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (ifd < 0)
+		return;
+
+	len = readlinkat(ifd, "driver", link, sizeof(link) - 1);
+	if (len >= 0) {
+		link[len] = '\0';
+		driver = strrchr(link, '/');
+		driver = driver ? driver + 1 : link;
+		if (strlen(driver) < sizeof(intf->driver))
+			strcpy(intf->driver, driver);
+	}
+
+	intf->num_eps = list_dir(ifd, "ep_??", &eps);
+	intf->eps = calloc(intf->num_eps ? intf->num_eps : 1, sizeof(*intf->eps));
+	if (!intf->eps)
+		intf->num_eps = 0;
+	for (i = 0; i < intf->num_eps; i++) {
+		/* Endpoints are directories, or links to them */
+		if (fstatat(ifd, eps[i], &st, 0) < 0 || !S_ISDIR(st.st_mode)) {
+			memmove(&eps[i], &eps[i + 1], (intf->num_eps - i - 1) * sizeof(*eps));
+			free(eps[--intf->num_eps]);
+			i--;
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", name, eps[i]);
+		for (int j = 0; j < EP_ATTR_NUM; j++)
+			queue_attr(path, ep_attr_names[j], &intf->eps[i].attr[j]);
+	}
+
+	free_names(eps, intf->num_eps);
+	close(ifd);
+}
+
+static void walk_device(int sysfs_fd, const char *name, int parent, int level, int count)
+{
+	char pattern[32], **ifs, **children;
+	struct device *dev, **tmp;
+	const char *p, *q;
+	regex_t child_re;
+	int i, idx, n, bus, dfd, devcount = 0;
+
+	dfd = openat(sysfs_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0)
+		return;
+
+	if (num_devices == alloc_devices) {
+		alloc_devices = alloc_devices ? alloc_devices * 2 : 32;
+		tmp = realloc(devices, alloc_devices * sizeof(*devices));
+		if (!tmp)
+			goto out;
+		devices = tmp;
+	}
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		goto out;
+	idx = num_devices++;
+	devices[idx] = dev;
+
+	dev->level = level;
+	dev->parent = parent;
+	dev->count = count;
+	if (level > 0) {
+		for (p = q = name; *q; q++)
+			if (*q == '-' || *q == '.')
+				p = q + 1;
+		dev->port = atoi(p) - 1;
+	}
+
+	for (i = 0; i < DEV_ATTR_NUM; i++)
+		queue_attr(name, dev_attr_names[i], &dev->attr[i]);
+	for (i = 0; i < STR_NUM; i++) {
+		dev->str[i].len = -ENOENT;
+		sysfs_batch_add(batch, name, str_attr_names[i], dev->str[i].buf,
+				sizeof(dev->str[i].buf), store_len, &dev->str[i].len);
+	}
+
+	/* The bus number, as in the names of the interfaces and children */
+	bus = strncmp(name, "usb", 3) ? atoi(name) : atoi(name + 3);
+
+	snprintf(pattern, sizeof(pattern), "%d-*:?.*", bus);
+	dev->num_ifs = list_dir(dfd, pattern, &ifs);
+	dev->ifs = calloc(dev->num_ifs ? dev->num_ifs : 1, sizeof(*dev->ifs));
+	if (!dev->ifs)
+		dev->num_ifs = 0;
+	for (i = 0; i < dev->num_ifs; i++)
+		walk_interface(dfd, ifs[i], &dev->ifs[i]);
+	free_names(ifs, dev->num_ifs);
+
+	snprintf(pattern, sizeof(pattern), "^%d-[0-9]+(\\.[0-9]+)*$", bus);
+	if (regcomp(&child_re, pattern, REG_EXTENDED | REG_NOSUB))
+		goto out;
+	snprintf(pattern, sizeof(pattern), "%d-*", bus);
+	n = list_dir(dfd, pattern, &children);
+	for (i = 0; i < n; i++) {
+		if (regexec(&child_re, children[i], 0, NULL, 0))
+			continue;
+		devcount++;
+		walk_device(dfd, children[i], idx, level + 1, devcount);
+	}
+	free_names(children, n);
+	regfree(&child_re);
+
+out:
+	close(dfd);
+}
+
+static const char *class_decode(const char *class)
+{
+	static const struct {
+		const char *class;
+		const char *name;
+	} classes[] = {
+		{ "00", ">ifc " }, { "01", "audio" }, { "02", "commc" }, { "03", "HID  " },
+		{ "05", "PID  " }, { "06", "still" }, { "07", "print" }, { "08", "stor." },
+		{ "09", "hub  " }, { "0a", "data " }, { "0b", "scard" }, { "0d", "c-sec" },
+		{ "0e", "video" }, { "0f", "perhc" }, { "10", "av   " }, { "11", "blbrd" },
+		{ "12", "bridg" }, { "dc", "diagd" }, { "e0", "wlcon" }, { "ef", "misc " },
+		{ "fe", "app. " }, { "ff", "vend." },
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(classes) / sizeof(classes[0]); i++)
+		if (!strcmp(class, classes[i].class))
+			return classes[i].name;
+
+	return "unk. ";
+}
+
+static void print_endpoint(struct endpoint *ep)
+{
+	const char *dir = value(&ep->attr[EP_DIRECTION]);
+	const char *type = value(&ep->attr[EP_TYPE]);
+	long maxps = strtol(value(&ep->attr[EP_MAXPS]), NULL, 16);
+
+	if (!strcmp(dir, "in"))
+		dir = "I";
+	else if (!strcmp(dir, "out"))
+		dir = "O";
+	else if (!strcmp(dir, "both"))
+		dir = "B";
+
+	if (!strcmp(type, "Control"))
+		type = "Ctrl";
+	else if (!strcmp(type, "Interrupt"))
+		type = "Int.";
+
+	/* MaxPS size (bits 0-10) times the multiplicity (bits 11-12) */
+	printf("E:  Ad=%s(%s) Atr=%s(%s) MxPS=%4ld Ivl=%s\n",
+	       value(&ep->attr[EP_ADDRESS]), dir, value(&ep->attr[EP_ATTRIBUTES]), type,
+	       (maxps & 0x7ff) * (1 + ((maxps >> 11) & 0x3)), value(&ep->attr[EP_INTERVAL]));
+}
+
+static void print_interface(struct interface *intf)
+{
+	const char *class = value(&intf->attr[IF_CLASS]);
+	int i;
+
+	printf("I:  If#=%2ld Alt=%2s #EPs=%2ld Cls=%s(%s) Sub=%s Prot=%s Driver=%s\n",
+	       hex_number(&intf->attr[IF_NUMBER]), value(&intf->attr[IF_ALTSETTING]),
+	       hex_number(&intf->attr[IF_NUM_EPS]), class, class_decode(class),
+	       value(&intf->attr[IF_SUBCLASS]), value(&intf->attr[IF_PROTOCOL]), intf->driver);
+
+	for (i = 0; i < intf->num_eps; i++)
+		print_endpoint(&intf->eps[i]);
+}
+
+/* Like tr -d '\000-\037\177' */
+static void print_string(struct string_attr *s, const char *label)
+{
+	int i;
+
+	if (s->len == -ENOENT)
+		return;
+
+	printf("S:  %s=", label);
+	for (i = 0; i < s->len; i++)
+		if ((unsigned char)s->buf[i] >= 0x20 && s->buf[i] != 0x7f)
+			putchar(s->buf[i]);
+	putchar('\n');
+}
+
+static void print_device(struct device *dev)
+{
+	const char *class = value(&dev->attr[DEV_CLASS]);
+	const char *bcd = value(&dev->attr[DEV_BCD]);
+	int bcd_len = strlen(bcd), i;
+
+	printf("\nT:  Bus=%02ld Lev=%02d Prnt=%02ld Port=%02d Cnt=%02d Dev#=%3ld Spd=%-4s MxCh=%2ld\n",
+	       number(&dev->attr[DEV_BUSNUM]), dev->level,
+	       dev->parent < 0 ? 0 : number(&devices[dev->parent]->attr[DEV_DEVNUM]),
+	       dev->port, dev->count, number(&dev->attr[DEV_DEVNUM]),
+	       value(&dev->attr[DEV_SPEED]), number(&dev->attr[DEV_MAXCHILD]));
+
+	printf("D:  Ver=%5s Cls=%s(%s) Sub=%s Prot=%s MxPS=%2ld #Cfgs=%3ld\n",
+	       value(&dev->attr[DEV_VERSION]), class, class_decode(class),
+	       value(&dev->attr[DEV_SUBCLASS]), value(&dev->attr[DEV_PROTOCOL]),
+	       number(&dev->attr[DEV_MAXPS0]), number(&dev->attr[DEV_NUM_CONFIGS]));
+
+	/* The revision is split before and after its first and last two digits */
+	printf("P:  Vendor=%s ProdID=%s Rev=%.*s.%s\n",
+	       value(&dev->attr[DEV_VENDOR]), value(&dev->attr[DEV_PRODUCT]),
+	       bcd_len >= 2 ? bcd_len - 2 : bcd_len, bcd, bcd_len >= 2 ? bcd + 2 : bcd);
+
+	for (i = 0; i < STR_NUM; i++)
+		print_string(&dev->str[i], str_labels[i]);
+
+	printf("C:  #Ifs=%2ld Cfg#=%2ld Atr=%s MxPwr=%s\n",
+	       number(&dev->attr[DEV_NUM_IFS]), number(&dev->attr[DEV_CONFIG]),
+	       value(&dev->attr[DEV_ATTRIBUTES]), value(&dev->attr[DEV_MAXPOWER]));
+
+	for (i = 0; i < dev->num_ifs; i++)
+		print_interface(&dev->ifs[i]);
+}
+
+/* The root hubs, usbN, in the order of sort -V */
+static int compare_buses(const void *a, const void *b)
+{
+	const char *x = *(char *const *)a, *y = *(char *const *)b;
+	long nx = atol(x + 3), ny = atol(y + 3);
+
+	if (nx != ny)
+		return nx < ny ? -1 : 1;
+	return strcmp(x, y);
+}
+
+int main(void)
+{
+	struct stat st;
+	char **buses = NULL;
+	int i, j, n, sysfs_fd;
+
+	if (stat("/sys/bus", &st) < 0 || !S_ISDIR(st.st_mode)) {
+		fprintf(stderr, "Error: directory /sys/bus does not exist; is sysfs mounted?\n");
+		return 1;
+	}
+
+	batch = sysfs_batch_new();
+	if (!batch) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	sysfs_fd = open(SYSFS_DEV_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	n = sysfs_fd < 0 ? 0 : list_dir(sysfs_fd, "usb*", &buses);
+	qsort(buses, n, sizeof(*buses), compare_buses);
+	for (i = 0; i < n; i++)
+		walk_device(sysfs_fd, buses[i], -1, 0, 0);
+	free_names(buses, n);
+	if (sysfs_fd >= 0)
+		close(sysfs_fd);
+
+	sysfs_batch_run(batch);
+	sysfs_batch_free(batch);
+
+	for (i = 0; i < num_devices; i++) {
+		print_device(devices[i]);
+		for (j = 0; j < devices[i]->num_ifs; j++)
+			free(devices[i]->ifs[j].eps);
+		free(devices[i]->ifs);
+	}
+	for (i = 0; i < num_devices; i++)
+		free(devices[i]);
+	free(devices);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Built-in USB ID database, generated from usb.ids by gen-usb-ids.py
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef _USB_IDS_H
+#define _USB_IDS_H
+/* ---------------------------------------------------------------------- */
+
+/*
+ * The keys are the vendor ID for vendors, the vendor and product IDs for
+ * products, and the kind, class, subclass and protocol for classes, as
+ * packed in names.c.  Every table is sorted by key.
+ */
+struct usb_ids_entry {
+	uint32_t key;
+	uint32_t name;		/* offset in usb_ids_strings */
+};
+
+extern const char usb_ids_strings[];
+extern const struct usb_ids_entry usb_ids_vendors[];
+extern const size_t usb_ids_nvendors;
+extern const struct usb_ids_entry usb_ids_products[];
+extern const size_t usb_ids_nproducts;
+extern const struct usb_ids_entry usb_ids_classes[];
+extern const size_t usb_ids_nclasses;
+
+/* ---------------------------------------------------------------------- */
+#endif /* _USB_IDS_H */
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - binary capture format
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_CAPTURE_H__
+#define __UHD_CAPTURE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A binary capture is a file header followed by records, all integers
+ * little-endian.
+ *
+ * File header:
+ *   0  char[8]  magic, UHD_CAPTURE_MAGIC
+ *   8  uint32   format version, UHD_CAPTURE_VERSION
+ *  12  uint32   file header length, bytes; records start after it
+ *  16  uint64   CLOCK_REALTIME at capture start, ns
+ *  24  uint64   CLOCK_MONOTONIC at capture start, ns
+ *
+ * Record:
+ *   0  uint64   CLOCK_MONOTONIC timestamp, ns
+ *   8  uint32   data length, bytes
+ *  12  uint8    record type, see uhd_capture_type
+ *  13  uint8    bus number
+ *  14  uint8    device address
+ *  15  uint8    interface number
+ *  16  uint8    endpoint address, zero for descriptors and output
+ *               reports sent with SET_REPORT
+ *  17  uint8[3] reserved, zero
+ *  20           data
+ *
+ * The report descriptor of every captured interface is recorded before its
+ * stream: at the start, or as the interface appears, in hotplug mode.
+ */
+
+/** Binary capture magic */
+#define UHD_CAPTURE_MAGIC           "UHDCAP\r\n"
+
+/** Binary capture format version */
+#define UHD_CAPTURE_VERSION         1
+
+/** Binary capture file header length */
+#define UHD_CAPTURE_HEADER_LEN      32
+
+/** Binary capture record header length */
+#define UHD_CAPTURE_RECORD_LEN      20
+
+/** Binary capture record type */
+typedef enum uhd_capture_type {
+    UHD_CAPTURE_TYPE_DESCRIPTOR = 1,    /**< Report descriptor */
+    UHD_CAPTURE_TYPE_STREAM     = 2,    /**< Interrupt IN transfer data */
+    UHD_CAPTURE_TYPE_OUTPUT     = 3,    /**< Output report sent */
+} uhd_capture_type;
+
+static inline void
+uhd_capture_put_le(uint8_t *p, uint64_t v, size_t len)
+{
+    for (; len > 0; len--, v >>= 8)
+        *p++ = v & 0xff;
+}
+
+static inline uint64_t
+uhd_capture_get_le(const uint8_t *p, size_t len)
+{
+    uint64_t    v   = 0;
+
+    while (len-- > 0)
+        v = (v << 8) | p[len];
+
+    return v;
+}
+
+/**
+ * Format a binary capture file header.
+ *
+ * @param buf           Output buffer, UHD_CAPTURE_HEADER_LEN bytes.
+ * @param realtime_ns   CLOCK_REALTIME at capture start, ns.
+ * @param monotonic_ns  CLOCK_MONOTONIC at capture start, ns.
+ */
+static inline void
+uhd_capture_header(uint8_t *buf, uint64_t realtime_ns, uint64_t monotonic_ns)
+{
+    memcpy(buf, UHD_CAPTURE_MAGIC, 8);
+    uhd_capture_put_le(buf + 8, UHD_CAPTURE_VERSION, 4);
+    uhd_capture_put_le(buf + 12, UHD_CAPTURE_HEADER_LEN, 4);
+    uhd_capture_put_le(buf + 16, realtime_ns, 8);
+    uhd_capture_put_le(buf + 24, monotonic_ns, 8);
+}
+
+/**
+ * Format a binary capture record header.
+ *
+ * @param buf       Output buffer, UHD_CAPTURE_RECORD_LEN bytes.
+ * @param ts_ns     CLOCK_MONOTONIC timestamp, ns.
+ * @param len       Data length.
+ * @param type      Record type.
+ * @param bus_num   Bus number.
+ * @param dev_addr  Device address.
+ * @param iface_num Interface number.
+ * @param ep_addr   Endpoint address.
+ */
+static inline void
+uhd_capture_record(uint8_t         *buf,
+                   uint64_t         ts_ns,
+                   uint32_t         len,
+                   uhd_capture_type type,
+                   uint8_t          bus_num,
+                   uint8_t          dev_addr,
+                   uint8_t          iface_num,
+                   uint8_t          ep_addr)
+{
+    uhd_capture_put_le(buf, ts_ns, 8);
+    uhd_capture_put_le(buf + 8, len, 4);
+    buf[12] = type;
+    buf[13] = bus_num;
+    buf[14] = dev_addr;
+    buf[15] = iface_num;
+    buf[16] = ep_addr;
+    buf[17] = buf[18] = buf[19] = 0;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_CAPTURE_H__ */
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - duplicate report suppression
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "delta.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+uhd_delta *
+uhd_delta_new(void)
+{
+    return calloc(1, sizeof(uhd_delta));
+}
+
+
+void
+uhd_delta_free(uhd_delta *delta)
+{
+    size_t  id;
+
+    if (delta == NULL)
+        return;
+
+    for (id = 0; id < 256; id++)
+        free(delta->last[id]);
+    free(delta);
+}
+
+
+bool
+uhd_delta_changed(uhd_delta        *delta,
+                  uint8_t           id,
+                  const uint8_t    *data,
+                  size_t            len)
+{
+    uint8_t    *buf;
+
+    assert(delta != NULL);
+    assert(data != NULL || len == 0);
+
+    if (delta->last[id] != NULL && delta->len[id] == len &&
+        memcmp(delta->last[id], data, len) == 0)
+    {
+        delta->suppressed++;
+        delta->total++;
+        return false;
+    }
+
+    /* Remember the report, or just let it through if out of memory */
+    if (len > delta->size[id])
+    {
+        buf = realloc(delta->last[id], len);
+        if (buf == NULL)
+            return true;
+        delta->last[id] = buf;
+        delta->size[id] = len;
+    }
+    else if (delta->last[id] == NULL)
+    {
+        /* Mark empty reports as seen, too */
+        delta->last[id] = malloc(1);
+        if (delta->last[id] == NULL)
+            return true;
+        delta->size[id] = 1;
+    }
+    memcpy(delta->last[id], data, len);
+    delta->len[id] = len;
+
+    return true;
+}
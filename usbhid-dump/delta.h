@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - duplicate report suppression
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_DELTA_H__
+#define __UHD_DELTA_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * usbhid-dump duplicate report suppression state: the last report seen
+ * with every report ID, and the number of duplicates suppressed.
+ */
+typedef struct uhd_delta uhd_delta;
+
+struct uhd_delta {
+    uint64_t    suppressed;     /**< Duplicates suppressed since the last
+                                     summary */
+    uint64_t    total;          /**< Duplicates suppressed in total */
+    uint8_t    *last[256];      /**< Last report by ID, or NULL */
+    size_t      len[256];       /**< Last report length by ID */
+    size_t      size[256];      /**< Last report buffer size by ID */
+};
+
+/**
+ * Create new, empty duplicate report suppression state.
+ *
+ * @return New state, or NULL if failed to allocate.
+ */
+extern uhd_delta *uhd_delta_new(void);
+
+/**
+ * Free duplicate report suppression state.
+ *
+ * @param delta The state to free, could be NULL.
+ */
+extern void uhd_delta_free(uhd_delta *delta);
+
+/**
+ * Check if a report differs from the last one with the same ID,
+ * remembering it if so, and counting it as suppressed otherwise.
+ *
+ * @param delta The state to check against.
+ * @param id    Report ID, zero for unnumbered reports.
+ * @param data  Report data.
+ * @param len   Report length.
+ *
+ * @return True if the report changed and should be output, false if it
+ *         is a duplicate.
+ */
+extern bool uhd_delta_changed(uhd_delta        *delta,
+                              uint8_t           id,
+                              const uint8_t    *data,
+                              size_t            len);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_DELTA_H__ */
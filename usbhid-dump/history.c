@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - pre-trigger report history
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "history.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t
+uhd_history_slot_size(size_t data_max)
+{
+    /* A timestamp, a length and the data, see struct uhd_history */
+    return sizeof(uint64_t) + sizeof(size_t) + data_max;
+}
+
+
+uhd_history *
+uhd_history_new(size_t slot_num, size_t data_max)
+{
+    uhd_history    *history;
+
+    assert(slot_num > 0);
+
+    history = calloc(1, sizeof(*history));
+    if (history == NULL)
+        return NULL;
+
+    history->data_max = data_max;
+    history->slot_num = slot_num;
+
+    history->ts = malloc(history->slot_num * sizeof(*history->ts));
+    history->len = malloc(history->slot_num * sizeof(*history->len));
+    history->data = malloc(history->slot_num * data_max);
+    if (history->ts == NULL || history->len == NULL ||
+        (data_max > 0 && history->data == NULL))
+    {
+        uhd_history_free(history);
+        return NULL;
+    }
+
+    return history;
+}
+
+
+void
+uhd_history_free(uhd_history *history)
+{
+    if (history == NULL)
+        return;
+
+    free(history->ts);
+    free(history->len);
+    free(history->data);
+    free(history);
+}
+
+
+void
+uhd_history_put(uhd_history    *history,
+                uint64_t        ts,
+                const uint8_t  *data,
+                size_t          len)
+{
+    size_t  slot;
+
+    assert(history != NULL);
+    assert(data != NULL || len == 0);
+
+    /* Overwrite the oldest report, if full */
+    if (history->num == history->slot_num)
+        uhd_history_pop(history);
+
+    slot = (history->head + history->num) % history->slot_num;
+    if (len > history->data_max)
+        len = history->data_max;
+
+    history->ts[slot] = ts;
+    history->len[slot] = len;
+    if (len > 0)
+        memcpy(history->data + slot * history->data_max, data, len);
+    history->num++;
+}
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - pre-trigger report history
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_HISTORY_H__
+#define __UHD_HISTORY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum history memory budget per interface, bytes */
+#define UHD_HISTORY_SIZE_MAX    (64 * 1024 * 1024)
+
+/**
+ * usbhid-dump report history: the most recent reports of an interface,
+ * with their timestamps, in a fixed number of fixed-size slots. Putting a
+ * report into a full history overwrites the oldest one.
+ */
+typedef struct uhd_history uhd_history;
+
+struct uhd_history {
+    size_t      slot_num;   /**< Number of slots */
+    size_t      data_max;   /**< Maximum report length */
+    size_t      head;       /**< Index of the oldest report */
+    size_t      num;        /**< Number of reports held */
+    uint64_t   *ts;         /**< Report timestamps, by slot */
+    size_t     *len;        /**< Report lengths, by slot */
+    uint8_t    *data;       /**< Report data, data_max bytes per slot */
+};
+
+/**
+ * Retrieve the memory taken by a history slot.
+ *
+ * @param data_max  Maximum report length.
+ *
+ * @return Slot size, bytes.
+ */
+extern size_t uhd_history_slot_size(size_t data_max);
+
+/**
+ * Create a new, empty history.
+ *
+ * @param slot_num  Number of slots, at least one.
+ * @param data_max  Maximum report length, longer reports are truncated.
+ *
+ * @return New history, or NULL if failed to allocate.
+ */
+extern uhd_history *uhd_history_new(size_t slot_num, size_t data_max);
+
+/**
+ * Free a history.
+ *
+ * @param history   The history to free, could be NULL.
+ */
+extern void uhd_history_free(uhd_history *history);
+
+/**
+ * Put a report into a history, overwriting the oldest one if full.
+ *
+ * @param history   The history to put the report into.
+ * @param ts        Report timestamp.
+ * @param data      Report data.
+ * @param len       Report length.
+ */
+extern void uhd_history_put(uhd_history    *history,
+                            uint64_t        ts,
+                            const uint8_t  *data,
+                            size_t          len);
+
+/**
+ * Retrieve the oldest report in a history.
+ *
+ * @param history   The history to retrieve the report from.
+ * @param pts       Location for the report timestamp.
+ * @param pdata     Location for the report data pointer.
+ * @param plen      Location for the report length.
+ *
+ * @return True if retrieved, false if the history is empty.
+ */
+static inline bool
+uhd_history_oldest(const uhd_history   *history,
+                   uint64_t            *pts,
+                   const uint8_t      **pdata,
+                   size_t              *plen)
+{
+    if (history->num == 0)
+        return false;
+
+    *pts = history->ts[history->head];
+    *pdata = history->data + history->head * history->data_max;
+    *plen = history->len[history->head];
+    return true;
+}
+
+/**
+ * Remove the oldest report from a non-empty history.
+ *
+ * @param history   The history to remove the report from.
+ */
+static inline void
+uhd_history_pop(uhd_history *history)
+{
+    history->head = (history->head + 1) % history->slot_num;
+    history->num--;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_HISTORY_H__ */
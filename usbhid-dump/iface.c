@@ -25,6 +25,7 @@ uhd_iface_new(const uhd_dev    *dev,
               uint8_t           number,
               uint8_t           int_in_ep_addr,
               uint16_t          int_in_ep_maxp,
+              uint32_t          int_in_ep_interval,
               uint16_t          rd_len)
 {
     uhd_iface      *iface;
@@ -40,10 +41,25 @@ uhd_iface_new(const uhd_dev    *dev,
     iface->number           = number;
     iface->int_in_ep_addr   = int_in_ep_addr;
     iface->int_in_ep_maxp   = int_in_ep_maxp;
+    iface->int_in_ep_interval = int_in_ep_interval;
+    iface->int_out_ep_addr  = 0;
     iface->rd_len           = rd_len;
     iface->detached         = false;
     iface->claimed          = false;
-    iface->submitted        = false;
+    iface->submitted        = 0;
+    iface->stats            = NULL;
+    iface->transfer_list    = NULL;
+    iface->transfer_num     = 0;
+    iface->streaming        = false;
+    iface->restart_num      = 0;
+    iface->disconnected     = false;
+    iface->plan             = NULL;
+    iface->delta            = NULL;
+    iface->history          = NULL;
+    iface->last_ts          = 0;
+    iface->latency          = NULL;
+    iface->latency_next     = 0;
+    iface->latency_busy     = false;
 
     /* Format address string */
     lusb_dev = libusb_get_device(dev->handle);
@@ -64,11 +80,38 @@ uhd_iface_new(const uhd_dev    *dev,
 void
 uhd_iface_free(uhd_iface *iface)
 {
+    struct libusb_transfer *transfer;
+
     if (iface == NULL)
         return;
 
     assert(uhd_iface_valid(iface));
 
+    uhd_stats_free(iface->stats);
+    uhd_plan_free(iface->plan);
+    uhd_delta_free(iface->delta);
+    uhd_history_free(iface->history);
+    uhd_latency_free(iface->latency);
+
+    /*
+     * Only free the transfers if none of them are submitted. Better leak
+     * some memory than have some important memory overwritten.
+     */
+    if (iface->submitted == 0)
+    {
+        for (; iface->transfer_num > 0; iface->transfer_num--)
+        {
+            transfer = iface->transfer_list[iface->transfer_num - 1];
+            /* Buffers libusb doesn't free are device memory */
+            if (transfer != NULL && transfer->buffer != NULL &&
+                !(transfer->flags & LIBUSB_TRANSFER_FREE_BUFFER))
+                libusb_dev_mem_free(iface->dev->handle,
+                                    transfer->buffer, transfer->length);
+            libusb_free_transfer(transfer);
+        }
+        free(iface->transfer_list);
+    }
+
     free(iface);
 }
 
@@ -10,6 +10,11 @@
 
 #include <stdint.h>
 #include "dev.h"
+#include "stats.h"
+#include "plan.h"
+#include "delta.h"
+#include "history.h"
+#include "latency.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,7 +30,13 @@ struct uhd_iface {
     char                    addr_str[12];   /**< Address string */
     uint8_t                 int_in_ep_addr; /**< Interrupt IN EP address */
     uint16_t                int_in_ep_maxp; /**< Interrupt IN EP maximum
-                                                 packet size */
+                                                 payload per service
+                                                 interval */
+    uint32_t                int_in_ep_interval;
+                                            /**< Interrupt IN EP service
+                                                 interval, us */
+    uint8_t                 int_out_ep_addr;/**< Interrupt OUT EP address,
+                                                 or zero if none */
     uint16_t                rd_len;         /**< Report descriptor length */
     bool                    detached;       /**< True if the interface was
                                                  detached from the kernel
@@ -33,14 +44,44 @@ struct uhd_iface {
     bool                    claimed;        /**< True if the interface was
                                                  claimed */
     /*
-     * This is somewhat hackish and doesn't belong here, since theoretically
-     * there could be more than one transfer submitted for an interface.
-     * However, we don't do it yet. This flag is used to track transfer
-     * cancellation during stream dumping.
+     * This doesn't strictly belong here, but is the simplest way to track
+     * transfer completion and cancellation during stream dumping, given
+     * that the transfer callback only gets the interface.
      */
-    bool                    submitted;      /**< True if an asynchronous
-                                                 transfer has been submitted
-                                                 for the interface */
+    unsigned int            submitted;      /**< Number of asynchronous
+                                                 transfers currently
+                                                 submitted (in flight) for
+                                                 the interface */
+    uhd_stats              *stats;          /**< Stream statistics, or NULL
+                                                 if not collected */
+    struct libusb_transfer
+                          **transfer_list;  /**< Stream transfers, or NULL
+                                                 if not streaming */
+    unsigned int            transfer_num;   /**< Number of stream
+                                                 transfers */
+    bool                    streaming;      /**< True if the stream was
+                                                 started successfully */
+    unsigned int            restart_num;    /**< Number of stream restarts
+                                                 since the last report */
+    bool                    disconnected;   /**< True if the device was
+                                                 seen disconnecting */
+    uhd_plan               *plan;           /**< Report decoding plan, or
+                                                 NULL if not compiled */
+    uhd_delta              *delta;          /**< Duplicate report
+                                                 suppression state, or NULL
+                                                 if not suppressing */
+    uhd_history            *history;        /**< Pre-trigger report
+                                                 history, or NULL if
+                                                 dumping directly */
+    uint64_t                last_ts;        /**< Last stream report
+                                                 timestamp, zero if none */
+    uhd_latency            *latency;        /**< Round-trip latency
+                                                 measurement state, or NULL
+                                                 if not measuring */
+    uint64_t                latency_next;   /**< Time to send the next
+                                                 latency probe, ns */
+    bool                    latency_busy;   /**< True if a latency probe
+                                                 transfer is in flight */
 };
 
 /**
@@ -58,7 +99,10 @@ extern bool uhd_iface_valid(const uhd_iface *iface);
  * @param handle            Device handle.
  * @param number            Interface number.
  * @param int_in_ep_addr    Interrupt in endpoint address.
- * @param int_in_ep_maxp    Interrupt in endpoint maximum packet size.
+ * @param int_in_ep_maxp    Interrupt in endpoint maximum payload per
+ *                          service interval.
+ * @param int_in_ep_interval
+ *                          Interrupt in endpoint service interval, us.
  * @param rd_len            Report descriptor length.
  *
  * @return New interface or NULL, if failed to allocate.
@@ -67,10 +111,12 @@ extern uhd_iface *uhd_iface_new(const uhd_dev  *dev,
                                 uint8_t         number,
                                 uint8_t         int_in_ep_addr,
                                 uint16_t        int_in_ep_maxp,
+                                uint32_t        int_in_ep_interval,
                                 uint16_t        rd_len);
 
 /**
- * Free an interface.
+ * Free an interface, along with its stream transfers, unless any of
+ * them are still submitted.
  *
  * @param iface The interface to free, could be NULL.
  */
@@ -47,6 +47,77 @@ uhd_iface_list_free(uhd_iface *list)
 }
 
 
+/**
+ * Calculate the maximum payload of an interrupt endpoint per service
+ * interval, i.e. the size of a transfer which can take all the data the
+ * device can send at once.
+ *
+ * @param lusb_dev  The device the endpoint belongs to.
+ * @param ep        The endpoint descriptor.
+ *
+ * @return The maximum payload, bytes.
+ */
+static uint16_t
+uhd_iface_list_ep_maxp(libusb_device                              *lusb_dev,
+                       const struct libusb_endpoint_descriptor    *ep)
+{
+    struct libusb_ss_endpoint_companion_descriptor *comp;
+    int                                             speed;
+    uint32_t                                        maxp;
+
+    /* Packet size is in bits 10..0, see USB 2.0 spec, 9.6.6 */
+    maxp = ep->wMaxPacketSize & 0x7ff;
+
+    speed = libusb_get_device_speed(lusb_dev);
+    if (speed >= LIBUSB_SPEED_SUPER)
+    {
+        /*
+         * SuperSpeed endpoints can burst several packets per interval,
+         * see USB 3.2 spec, 9.6.7
+         */
+        if (libusb_get_ss_endpoint_companion_descriptor(NULL, ep, &comp) ==
+                LIBUSB_SUCCESS)
+        {
+            maxp = comp->wBytesPerInterval != 0
+                        ? comp->wBytesPerInterval
+                        : maxp * (comp->bMaxBurst + 1);
+            libusb_free_ss_endpoint_companion_descriptor(comp);
+        }
+    }
+    else if (speed == LIBUSB_SPEED_HIGH)
+    {
+        /*
+         * High-bandwidth endpoints transfer up to three packets per
+         * microframe, the number of additional ones in bits 12..11
+         */
+        maxp *= ((ep->wMaxPacketSize >> 11) & 3) + 1;
+    }
+
+    return maxp <= UINT16_MAX ? maxp : UINT16_MAX;
+}
+
+
+static uint32_t
+uhd_iface_list_ep_interval(libusb_device                           *lusb_dev,
+                           const struct libusb_endpoint_descriptor *ep)
+{
+    uint8_t b = ep->bInterval;
+
+    /*
+     * Low and full speed interrupt endpoints are serviced every bInterval
+     * frames, faster ones every 2^(bInterval-1) microframes, see USB 2.0
+     * spec, 9.6.6
+     */
+    if (libusb_get_device_speed(lusb_dev) >= LIBUSB_SPEED_HIGH)
+    {
+        b = b < 1 ? 1 : b > 16 ? 16 : b;
+        return 125u << (b - 1);
+    }
+
+    return (b < 1 ? 1 : b) * 1000u;
+}
+
+
 enum libusb_error
 uhd_iface_list_new(uhd_dev     *dev_list,
                    uhd_iface  **plist)
@@ -149,7 +220,11 @@ uhd_iface_list_new(uhd_dev     *dev_list,
                 iface = uhd_iface_new(
                             dev,
                             iface_desc->bInterfaceNumber,
-                            ep->bEndpointAddress, ep->wMaxPacketSize,
+                            ep->bEndpointAddress,
+                            uhd_iface_list_ep_maxp(
+                                libusb_get_device(dev->handle), ep),
+                            uhd_iface_list_ep_interval(
+                                libusb_get_device(dev->handle), ep),
                             rd_len);
                 if (iface == NULL)
                 {
@@ -157,6 +232,17 @@ uhd_iface_list_new(uhd_dev     *dev_list,
                     goto cleanup;
                 }
 
+                /* Remember the first interrupt OUT endpoint, if any */
+                for (ep = ep_list; (ep - ep_list) < ep_num; ep++)
+                    if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) ==
+                        LIBUSB_TRANSFER_TYPE_INTERRUPT &&
+                        (ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) ==
+                        LIBUSB_ENDPOINT_OUT)
+                    {
+                        iface->int_out_ep_addr = ep->bEndpointAddress;
+                        break;
+                    }
+
                 /* Add the interface */
                 iface->next = list;
                 list = iface;
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - round-trip latency measurement
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "latency.h"
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int
+uhd_latency_xdigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower((int)c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+
+uhd_latency *
+uhd_latency_parse(const char *str)
+{
+    uint8_t         report[UHD_LATENCY_REPORT_MAX];
+    size_t          len         = 0;
+    long            seq_offset  = -1;
+    const char     *p;
+    char           *end;
+    unsigned long   n;
+    int             hi;
+    int             lo;
+
+    assert(str != NULL);
+
+    for (p = str;
+         (hi = uhd_latency_xdigit(p[0])) >= 0 &&
+         (lo = uhd_latency_xdigit(p[1])) >= 0;
+         p += 2)
+    {
+        if (len >= sizeof(report))
+            return NULL;
+        report[len++] = (hi << 4) | lo;
+    }
+    if (len == 0)
+        return NULL;
+
+    if (*p == '@')
+    {
+        p++;
+        if (!isdigit((int)*p))
+            return NULL;
+        errno = 0;
+        n = strtoul(p, &end, 10);
+        if (errno != 0 || n >= len)
+            return NULL;
+        seq_offset = n;
+        p = end;
+    }
+    if (*p != '\0')
+        return NULL;
+
+    return uhd_latency_new(report, len, seq_offset);
+}
+
+
+uhd_latency *
+uhd_latency_new(const uint8_t *report, size_t len, long seq_offset)
+{
+    uhd_latency    *latency;
+
+    assert(report != NULL || len == 0);
+    assert(len <= UHD_LATENCY_REPORT_MAX);
+    assert(seq_offset < (long)len);
+
+    latency = calloc(1, sizeof(*latency));
+    if (latency == NULL)
+        return NULL;
+
+    if (len > 0)
+        memcpy(latency->report, report, len);
+    latency->len = len;
+    latency->seq_offset = seq_offset;
+
+    return latency;
+}
+
+
+void
+uhd_latency_free(uhd_latency *latency)
+{
+    free(latency);
+}
+
+
+const uint8_t *
+uhd_latency_next(uhd_latency *latency)
+{
+    assert(latency != NULL);
+
+    /* Start from the specified byte value, wrapping around */
+    if (latency->seq_offset >= 0 && latency->sent > 0)
+        latency->report[latency->seq_offset]++;
+
+    return latency->report;
+}
+
+
+void
+uhd_latency_sent(uhd_latency   *latency,
+                 uint64_t       ts,
+                 const uint8_t *data,
+                 size_t         len)
+{
+    assert(latency != NULL);
+    assert(data != NULL || len == 0);
+
+    if (latency->pending)
+        latency->lost++;
+
+    /* Remember what was actually sent, e.g. when replaying a capture */
+    if (len > UHD_LATENCY_REPORT_MAX)
+        len = UHD_LATENCY_REPORT_MAX;
+    if (data != latency->report && len > 0)
+        memcpy(latency->report, data, len);
+    latency->len = len;
+
+    latency->pending = true;
+    latency->sent_ts = ts;
+    latency->sent++;
+}
+
+
+void
+uhd_latency_abort(uhd_latency *latency)
+{
+    assert(latency != NULL);
+
+    if (latency->pending)
+    {
+        latency->pending = false;
+        latency->lost++;
+    }
+}
+
+
+bool
+uhd_latency_received(uhd_latency   *latency,
+                     uint64_t       ts,
+                     const uint8_t *data,
+                     size_t         len)
+{
+    assert(latency != NULL);
+    assert(data != NULL || len == 0);
+
+    if (!latency->pending || len < latency->len ||
+        memcmp(data, latency->report, latency->len) != 0)
+        return false;
+
+    latency->pending = false;
+    latency->answered++;
+    uhd_stats_add_time(&latency->stats,
+                       ts > latency->sent_ts ? ts - latency->sent_ts : 0);
+
+    return true;
+}
+
+
+bool
+uhd_latency_print(FILE                 *stream,
+                  const char           *name,
+                  const uhd_latency    *latency)
+{
+    assert(latency != NULL);
+
+    return fprintf(stream,
+                   "%s: %llu probes, %llu answered, %llu lost, round-trip "
+                   "p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                   name,
+                   (unsigned long long int)latency->sent,
+                   (unsigned long long int)latency->answered,
+                   (unsigned long long int)latency->lost,
+                   uhd_stats_percentile(&latency->stats, 50) / 1e6,
+                   uhd_stats_percentile(&latency->stats, 99) / 1e6,
+                   latency->stats.max / 1e6) >= 0;
+}
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - round-trip latency measurement
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_LATENCY_H__
+#define __UHD_LATENCY_H__
+
+#include "stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a latency probe output report */
+#define UHD_LATENCY_REPORT_MAX  64
+
+/**
+ * usbhid-dump round-trip latency measurement state of an interface.
+ *
+ * An output report is sent to the device as a probe, one at a time, and
+ * the first input report starting with the same bytes is taken as its
+ * answer. If a sequence byte offset is given, the byte at it is
+ * incremented for every probe, so a late answer to a previous probe is
+ * not mistaken for the current one. A probe not answered before the next
+ * one is sent is counted as lost.
+ */
+typedef struct uhd_latency uhd_latency;
+
+struct uhd_latency {
+    uint8_t     report[UHD_LATENCY_REPORT_MAX]; /**< Probe output report */
+    size_t      len;                            /**< Probe length */
+    long        seq_offset;                     /**< Sequence byte offset,
+                                                     or -1 if none */
+    bool        pending;                        /**< True if the last
+                                                     probe is not answered
+                                                     yet */
+    uint64_t    sent_ts;                        /**< Last probe timestamp,
+                                                     ns */
+    uint64_t    sent;                           /**< Number of probes
+                                                     sent */
+    uint64_t    answered;                       /**< Number of probes
+                                                     answered */
+    uint64_t    lost;                           /**< Number of probes
+                                                     lost */
+    uhd_stats   stats;                          /**< Round-trip time
+                                                     histogram */
+};
+
+/**
+ * Parse a probe specification: "HEX[@OFFSET]", the output report bytes
+ * in hex, optionally followed by the decimal offset of the sequence byte.
+ *
+ * @param str   The specification to parse.
+ *
+ * @return New latency measurement state, or NULL if the specification is
+ *         invalid, or failed to allocate memory.
+ */
+extern uhd_latency *uhd_latency_parse(const char *str);
+
+/**
+ * Create new latency measurement state.
+ *
+ * @param report        Probe output report, could be NULL if len is zero.
+ * @param len           Probe length, at most UHD_LATENCY_REPORT_MAX.
+ * @param seq_offset    Sequence byte offset, or -1 if none.
+ *
+ * @return New latency measurement state, or NULL if failed to allocate.
+ */
+extern uhd_latency *uhd_latency_new(const uint8_t  *report,
+                                    size_t          len,
+                                    long            seq_offset);
+
+/**
+ * Free latency measurement state.
+ *
+ * @param latency   The state to free, could be NULL.
+ */
+extern void uhd_latency_free(uhd_latency *latency);
+
+/**
+ * Prepare the next probe, advancing the sequence byte, if any.
+ *
+ * @param latency   The measurement state.
+ *
+ * @return The probe output report, latency->len bytes.
+ */
+extern const uint8_t *uhd_latency_next(uhd_latency *latency);
+
+/**
+ * Account a probe sent, counting the previous one lost, if unanswered.
+ *
+ * @param latency   The measurement state.
+ * @param ts        Probe timestamp, CLOCK_MONOTONIC ns.
+ * @param data      Probe output report.
+ * @param len       Probe length.
+ */
+extern void uhd_latency_sent(uhd_latency   *latency,
+                             uint64_t       ts,
+                             const uint8_t *data,
+                             size_t         len);
+
+/**
+ * Account a probe which failed to be sent.
+ *
+ * @param latency   The measurement state.
+ */
+extern void uhd_latency_abort(uhd_latency *latency);
+
+/**
+ * Check if an input report answers the pending probe and account the
+ * round-trip time, if so.
+ *
+ * @param latency   The measurement state.
+ * @param ts        Input report timestamp, CLOCK_MONOTONIC ns.
+ * @param data      Input report data.
+ * @param len       Input report length.
+ *
+ * @return True if the report answered the probe, false otherwise.
+ */
+extern bool uhd_latency_received(uhd_latency   *latency,
+                                 uint64_t       ts,
+                                 const uint8_t *data,
+                                 size_t         len);
+
+/**
+ * Print a one-line summary of latency measurement.
+ *
+ * @param stream    The stream to print to.
+ * @param name      The name to prefix the line with.
+ * @param latency   The measurement state to print.
+ *
+ * @return True if printed successfully, false otherwise.
+ */
+extern bool uhd_latency_print(FILE                 *stream,
+                              const char           *name,
+                              const uhd_latency    *latency);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_LATENCY_H__ */
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - event loop
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "loop.h"
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/* Define LIBUSB_CALL for libusb <= 1.0.8 */
+#ifndef LIBUSB_CALL
+#define LIBUSB_CALL
+#endif
+
+/** Maximum number of file descriptor events handled per wakeup */
+#define EVENT_MAX   16
+
+struct uhd_loop {
+    libusb_context *ctx;        /**< libusb context */
+    int             epoll_fd;   /**< epoll instance, or -1 if falling back
+                                     to libusb_handle_events() */
+    int             wake_fd;    /**< Wakeup eventfd */
+    uint64_t        deadline;   /**< CLOCK_MONOTONIC time to return by,
+                                     ns, or zero if none */
+};
+
+
+static void LIBUSB_CALL
+uhd_loop_pollfd_added(int fd, short events, void *user_data)
+{
+    uhd_loop           *loop    = user_data;
+    struct epoll_event  ev      = {.data.fd = fd};
+
+    if (events & POLLIN)
+        ev.events |= EPOLLIN;
+    if (events & POLLOUT)
+        ev.events |= EPOLLOUT;
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 &&
+        errno == EEXIST)
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+
+static void LIBUSB_CALL
+uhd_loop_pollfd_removed(int fd, void *user_data)
+{
+    uhd_loop   *loop    = user_data;
+
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+
+uhd_loop *
+uhd_loop_new(libusb_context *ctx)
+{
+    uhd_loop                   *loop;
+    const struct libusb_pollfd **pollfd_list;
+    const struct libusb_pollfd **ppollfd;
+    struct epoll_event          ev      = {.events = EPOLLIN};
+
+    assert(ctx != NULL);
+
+    loop = malloc(sizeof(*loop));
+    if (loop == NULL)
+        return NULL;
+
+    loop->ctx       = ctx;
+    loop->epoll_fd  = -1;
+    loop->wake_fd   = -1;
+    loop->deadline  = 0;
+
+    pollfd_list = libusb_get_pollfds(ctx);
+    if (pollfd_list == NULL)
+        return loop;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0)
+        goto fallback;
+
+    loop->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (loop->wake_fd < 0)
+        goto fallback;
+    ev.data.fd = loop->wake_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0)
+        goto fallback;
+
+    for (ppollfd = pollfd_list; *ppollfd != NULL; ppollfd++)
+        uhd_loop_pollfd_added((*ppollfd)->fd, (*ppollfd)->events, loop);
+    libusb_free_pollfds(pollfd_list);
+    pollfd_list = NULL;
+
+    libusb_set_pollfd_notifiers(ctx,
+                                uhd_loop_pollfd_added,
+                                uhd_loop_pollfd_removed,
+                                loop);
+
+    return loop;
+
+fallback:
+    /* Out of file descriptors, most likely - libusb can still do it */
+    libusb_free_pollfds(pollfd_list);
+    if (loop->wake_fd >= 0)
+        close(loop->wake_fd);
+    if (loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    loop->epoll_fd  = -1;
+    loop->wake_fd   = -1;
+    return loop;
+}
+
+
+void
+uhd_loop_free(uhd_loop *loop)
+{
+    if (loop == NULL)
+        return;
+
+    if (loop->epoll_fd >= 0)
+    {
+        libusb_set_pollfd_notifiers(loop->ctx, NULL, NULL, NULL);
+        close(loop->wake_fd);
+        close(loop->epoll_fd);
+    }
+
+    free(loop);
+}
+
+
+enum libusb_error
+uhd_loop_run_once(uhd_loop *loop)
+{
+    struct timeval      zero    = {0, 0};
+    struct timeval      tv;
+    struct timespec     now;
+    struct epoll_event  ev[EVENT_MAX];
+    int                 timeout = -1;
+    int                 left    = -1;
+    uint64_t            now_ns;
+    int                 rc;
+    int                 i;
+    bool                usb     = false;
+    uint64_t            value;
+
+    assert(loop != NULL);
+
+    /* Find out how long until the deadline, if any, in ms, rounding up */
+    if (loop->deadline != 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        now_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+        left = now_ns >= loop->deadline
+                    ? 0
+                    : (loop->deadline - now_ns + 999999) / 1000000;
+    }
+
+    if (loop->epoll_fd < 0)
+    {
+        if (left < 0)
+            return libusb_handle_events(loop->ctx);
+        tv.tv_sec = left / 1000;
+        tv.tv_usec = (left % 1000) * 1000;
+        return libusb_handle_events_timeout_completed(loop->ctx, &tv, NULL);
+    }
+
+    /* Wake up for libusb's own timeouts, if it has any pending */
+    rc = libusb_get_next_timeout(loop->ctx, &tv);
+    if (rc < 0)
+        return rc;
+    if (rc > 0)
+        timeout = tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+    /* And for the deadline */
+    if (left >= 0 && (timeout < 0 || left < timeout))
+        timeout = left;
+
+    rc = epoll_wait(loop->epoll_fd, ev, EVENT_MAX, timeout);
+    if (rc < 0)
+        return errno == EINTR ? LIBUSB_ERROR_INTERRUPTED
+                              : LIBUSB_ERROR_OTHER;
+
+    for (i = 0; i < rc; i++)
+        if (ev[i].data.fd == loop->wake_fd)
+        {
+            while (read(loop->wake_fd, &value, sizeof(value)) < 0 &&
+                   errno == EINTR);
+        }
+        else
+            usb = true;
+
+    /* Handle whatever is ready, or timed out, without blocking */
+    if (usb || rc == 0)
+        return libusb_handle_events_timeout_completed(loop->ctx,
+                                                      &zero, NULL);
+
+    return LIBUSB_SUCCESS;
+}
+
+
+void
+uhd_loop_set_deadline(uhd_loop *loop, uint64_t deadline)
+{
+    assert(loop != NULL);
+    loop->deadline = deadline;
+}
+
+
+void
+uhd_loop_wake(uhd_loop *loop)
+{
+    uint64_t    value           = 1;
+    ssize_t     rc;
+    int         saved_errno     = errno;
+
+    if (loop != NULL && loop->wake_fd >= 0)
+    {
+        rc = write(loop->wake_fd, &value, sizeof(value));
+        (void)rc;
+    }
+
+    errno = saved_errno;
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - event loop
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_LOOP_H__
+#define __UHD_LOOP_H__
+
+#include <libusb.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * usbhid-dump event loop.
+ *
+ * Waits for the libusb file descriptors with epoll(7), keeping the set
+ * up to date with the libusb pollfd notifiers, along with an eventfd(2)
+ * which can be signalled to wake the loop up, e.g. from a signal
+ * handler. Falls back to plain libusb_handle_events() if libusb doesn't
+ * expose its file descriptors, or the epoll instance or the eventfd can't
+ * be created.
+ */
+typedef struct uhd_loop uhd_loop;
+
+/**
+ * Create an event loop for a libusb context.
+ *
+ * @param ctx   The libusb context to handle events of.
+ *
+ * @return New event loop, or NULL if failed to allocate. If epoll(7)
+ *         can't be set up, the loop falls back to libusb_handle_events().
+ */
+extern uhd_loop *uhd_loop_new(libusb_context *ctx);
+
+/**
+ * Free an event loop.
+ *
+ * @param loop  The loop to free, could be NULL.
+ */
+extern void uhd_loop_free(uhd_loop *loop);
+
+/**
+ * Wait for and handle libusb events, until there are some, the loop
+ * is woken up, or the deadline passes.
+ *
+ * @param loop  The loop to run.
+ *
+ * @return LIBUSB_SUCCESS, LIBUSB_ERROR_INTERRUPTED if interrupted by a
+ *         signal, or another libusb error code.
+ */
+extern enum libusb_error uhd_loop_run_once(uhd_loop *loop);
+
+/**
+ * Set the time by which uhd_loop_run_once() should return, even if
+ * there are no events, e.g. to do something on schedule.
+ *
+ * @param loop      The loop to set the deadline for.
+ * @param deadline  CLOCK_MONOTONIC time, ns, or zero for no deadline.
+ */
+extern void uhd_loop_set_deadline(uhd_loop *loop, uint64_t deadline);
+
+/**
+ * Wake an event loop up. Async-signal-safe.
+ *
+ * @param loop  The loop to wake up.
+ */
+extern void uhd_loop_wake(uhd_loop *loop);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_LOOP_H__ */
@@ -45,6 +45,9 @@ struct uhd_hid_descriptor {
  */
 #define UHD_MAX_DESCRIPTOR_SIZE 4096
 
+/** Maximum number of stream transfers submitted per interface */
+#define UHD_STREAM_QUEUE_MAX    64
+
 /** Generic USB I/O timeout, ms */
 #define UHD_IO_TIMEOUT      1000
 
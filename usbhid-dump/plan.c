@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - report decoding plan
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "plan.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum global item stack depth */
+#define GLOBAL_STACK_MAX    8
+
+/** Maximum number of usages of a main item, after range expansion */
+#define LOCAL_USAGE_MAX     4096
+
+/** Item types, see HID spec, 6.2.2.2 */
+enum item_type {
+    ITEM_TYPE_MAIN      = 0,
+    ITEM_TYPE_GLOBAL    = 1,
+    ITEM_TYPE_LOCAL     = 2,
+};
+
+/** Main item tags, see HID spec, 6.2.2.4 */
+enum main_tag {
+    MAIN_TAG_INPUT      = 0x8,
+};
+
+/** Global item tags, see HID spec, 6.2.2.7 */
+enum global_tag {
+    GLOBAL_TAG_USAGE_PAGE   = 0x0,
+    GLOBAL_TAG_LOGICAL_MIN  = 0x1,
+    GLOBAL_TAG_REPORT_SIZE  = 0x7,
+    GLOBAL_TAG_REPORT_ID    = 0x8,
+    GLOBAL_TAG_REPORT_COUNT = 0x9,
+    GLOBAL_TAG_PUSH         = 0xA,
+    GLOBAL_TAG_POP          = 0xB,
+};
+
+/** Local item tags, see HID spec, 6.2.2.8 */
+enum local_tag {
+    LOCAL_TAG_USAGE         = 0x0,
+    LOCAL_TAG_USAGE_MIN     = 0x1,
+    LOCAL_TAG_USAGE_MAX     = 0x2,
+};
+
+/** Input, Output and Feature item data bits */
+#define MAIN_CONSTANT   0x01
+#define MAIN_VARIABLE   0x02
+
+/** Global item state */
+typedef struct global {
+    uint32_t    usage_page;
+    int32_t     logical_min;
+    uint32_t    report_size;
+    uint32_t    report_count;
+    uint8_t     report_id;
+} global;
+
+/** Plan compiler state */
+typedef struct compiler {
+    uhd_plan   *plan;
+    global      stack[GLOBAL_STACK_MAX];    /**< Global item stack, the
+                                                 current state on top */
+    size_t      depth;                      /**< Index of the stack top */
+    uint32_t    usage[LOCAL_USAGE_MAX];     /**< Extended local usages */
+    size_t      usage_num;                  /**< Number of local usages */
+    uint32_t    usage_min;                  /**< Extended usage minimum */
+    bool        usage_min_set;              /**< True if the usage minimum
+                                                 awaits its maximum */
+    uint32_t    bits[256];                  /**< Input report lengths so
+                                                 far, by ID, bits */
+} compiler;
+
+
+static void
+usage_name(uint32_t usage, char *buf, size_t size)
+{
+    static const char  *const desktop[] = {
+        [0x30] = "X",       [0x31] = "Y",       [0x32] = "Z",
+        [0x33] = "Rx",      [0x34] = "Ry",      [0x35] = "Rz",
+        [0x36] = "Slider",  [0x37] = "Dial",    [0x38] = "Wheel",
+        [0x39] = "Hat",
+    };
+    uint16_t            page    = usage >> 16;
+    uint16_t            id      = usage & 0xffff;
+
+    if (page == 0x01 && id < sizeof(desktop) / sizeof(*desktop) &&
+        desktop[id] != NULL)
+        snprintf(buf, size, "%s", desktop[id]);
+    else if (page == 0x09)
+        snprintf(buf, size, "Button%u", id);
+    else
+        snprintf(buf, size, "%.4X:%.4X", page, id);
+}
+
+
+static bool
+add_usage(compiler *c, uint32_t usage)
+{
+    if (c->usage_num >= LOCAL_USAGE_MAX)
+        return false;
+    c->usage[c->usage_num++] = usage;
+    return true;
+}
+
+
+static bool
+add_field(compiler         *c,
+          uint8_t           id,
+          uint32_t          bit,
+          const global     *g,
+          bool              array,
+          uint32_t          usage_idx,
+          uint32_t          usage_num,
+          uint32_t          usage)
+{
+    uhd_plan_report    *report  = c->plan->report[id];
+    uhd_plan_field     *list;
+    uhd_plan_field     *field;
+
+    if (report == NULL)
+    {
+        report = calloc(1, sizeof(*report));
+        if (report == NULL)
+            return false;
+        c->plan->report[id] = report;
+    }
+
+    /* Grow the field list by powers of two */
+    if ((report->field_num & (report->field_num - 1)) == 0)
+    {
+        list = realloc(report->field_list,
+                       sizeof(*list) * (report->field_num == 0
+                                            ? 1 : report->field_num * 2));
+        if (list == NULL)
+            return false;
+        report->field_list = list;
+    }
+
+    field = report->field_list + report->field_num++;
+    memset(field, 0, sizeof(*field));
+    /* The report ID byte is accounted for when done */
+    field->byte         = bit / 8;
+    field->shift        = bit % 8;
+    field->size         = g->report_size;
+    field->span         = (field->shift + field->size + 7) / 8;
+    field->mask         = field->size == 32 ? UINT32_MAX
+                                            : ((uint32_t)1 << field->size) - 1;
+    field->is_signed    = g->logical_min < 0;
+    field->array        = array;
+    field->logical_min  = g->logical_min;
+    field->usage_idx    = usage_idx;
+    field->usage_num    = usage_num;
+    if (!array)
+        usage_name(usage, field->name, sizeof(field->name));
+
+    return true;
+}
+
+
+static bool
+compile_input(compiler *c, uint32_t flags)
+{
+    const global   *g       = &c->stack[c->depth];
+    uint32_t       *bits    = &c->bits[g->report_id];
+    uint32_t       *list;
+    uint32_t        usage_idx;
+    uint32_t        i;
+
+    if (g->report_id != 0)
+        c->plan->numbered = true;
+
+    /* Keep the offsets representable */
+    if (*bits + (uint64_t)g->report_size * g->report_count >
+            (uint32_t)UINT16_MAX * 8)
+        return false;
+
+    /* Skip padding and fields too large to extract */
+    if ((flags & MAIN_CONSTANT) || g->report_size == 0 ||
+        g->report_size > 32 || c->usage_num == 0)
+        goto advance;
+
+    if (flags & MAIN_VARIABLE)
+    {
+        /* The last usage applies to the rest of the fields */
+        for (i = 0; i < g->report_count; i++)
+            if (!add_field(c, g->report_id, *bits + i * g->report_size, g,
+                           false, 0, 1,
+                           c->usage[i < c->usage_num ? i
+                                                     : c->usage_num - 1]))
+                return false;
+    }
+    else
+    {
+        /* Array fields share the usage list */
+        list = realloc(c->plan->usage_list,
+                       sizeof(*list) * (c->plan->usage_num + c->usage_num));
+        if (list == NULL)
+            return false;
+        c->plan->usage_list = list;
+        usage_idx = c->plan->usage_num;
+        memcpy(list + usage_idx, c->usage, sizeof(*list) * c->usage_num);
+        c->plan->usage_num += c->usage_num;
+
+        for (i = 0; i < g->report_count; i++)
+            if (!add_field(c, g->report_id, *bits + i * g->report_size, g,
+                           true, usage_idx, c->usage_num, 0))
+                return false;
+    }
+
+advance:
+    *bits += g->report_size * g->report_count;
+    return true;
+}
+
+
+uhd_plan *
+uhd_plan_new(const uint8_t *rd, size_t len)
+{
+    compiler           *c;
+    uhd_plan           *plan    = NULL;
+    const uint8_t      *p       = rd;
+    const uint8_t      *end     = rd + len;
+    uint8_t             prefix;
+    size_t              size;
+    uint32_t            data;
+    int32_t             sdata;
+    global             *g;
+    uhd_plan_report    *report;
+    size_t              i;
+    size_t              id;
+    uint32_t            usage;
+
+    assert(rd != NULL || len == 0);
+
+    c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return NULL;
+    c->plan = calloc(1, sizeof(*c->plan));
+    if (c->plan == NULL)
+        goto cleanup;
+    c->plan->refs = 1;
+
+    while (p < end)
+    {
+        prefix = *p++;
+
+        /* Skip long items, see HID spec, 6.2.2.3 */
+        if (prefix == 0xFE)
+        {
+            if (end - p < 2 || (size_t)(end - p) < 2u + p[0])
+                goto cleanup;
+            p += 2 + p[0];
+            continue;
+        }
+
+        size = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+        if ((size_t)(end - p) < size)
+            goto cleanup;
+        for (data = 0, i = size; i > 0; i--)
+            data = (data << 8) | p[i - 1];
+        sdata = size == 1 ? (int8_t)data
+              : size == 2 ? (int16_t)data
+                          : (int32_t)data;
+        p += size;
+
+        g = &c->stack[c->depth];
+        switch (((prefix >> 2) & 0x3) << 4 | prefix >> 4)
+        {
+            case ITEM_TYPE_MAIN << 4 | MAIN_TAG_INPUT:
+                if (!compile_input(c, data))
+                    goto cleanup;
+                /* fall through */
+            case ITEM_TYPE_MAIN << 4 | 0x9:     /* Output */
+            case ITEM_TYPE_MAIN << 4 | 0xA:     /* Collection */
+            case ITEM_TYPE_MAIN << 4 | 0xB:     /* Feature */
+            case ITEM_TYPE_MAIN << 4 | 0xC:     /* End Collection */
+                c->usage_num = 0;
+                c->usage_min_set = false;
+                break;
+
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_USAGE_PAGE:
+                g->usage_page = data;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_LOGICAL_MIN:
+                g->logical_min = sdata;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_REPORT_SIZE:
+                g->report_size = data;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_REPORT_ID:
+                if (data == 0 || data > UINT8_MAX)
+                    goto cleanup;
+                g->report_id = data;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_REPORT_COUNT:
+                g->report_count = data;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_PUSH:
+                if (c->depth + 1 >= GLOBAL_STACK_MAX)
+                    goto cleanup;
+                c->stack[c->depth + 1] = *g;
+                c->depth++;
+                break;
+            case ITEM_TYPE_GLOBAL << 4 | GLOBAL_TAG_POP:
+                if (c->depth == 0)
+                    goto cleanup;
+                c->depth--;
+                break;
+
+            /*
+             * Short usages take the usage page current at the time they
+             * are seen, rather than at the main item.
+             */
+            case ITEM_TYPE_LOCAL << 4 | LOCAL_TAG_USAGE:
+                if (!add_usage(c, size == 4 ? data
+                                            : g->usage_page << 16 | data))
+                    goto cleanup;
+                break;
+            case ITEM_TYPE_LOCAL << 4 | LOCAL_TAG_USAGE_MIN:
+                c->usage_min = size == 4 ? data
+                                         : g->usage_page << 16 | data;
+                c->usage_min_set = true;
+                break;
+            /*
+             * Refuse ranges without a minimum, or not fitting, rather
+             * than decode with made up usages.
+             */
+            case ITEM_TYPE_LOCAL << 4 | LOCAL_TAG_USAGE_MAX:
+                if (size != 4)
+                    data |= g->usage_page << 16;
+                if (!c->usage_min_set || data < c->usage_min ||
+                    data - c->usage_min >= LOCAL_USAGE_MAX - c->usage_num)
+                    goto cleanup;
+                for (usage = 0; usage <= data - c->usage_min; usage++)
+                    add_usage(c, c->usage_min + usage);
+                c->usage_min_set = false;
+                break;
+        }
+    }
+
+    /* Account for the report ID byte now it's known to be there */
+    for (id = 0; id < 256; id++)
+    {
+        report = c->plan->report[id];
+        if (report == NULL)
+            continue;
+        report->len = (c->bits[id] + 7) / 8 + c->plan->numbered;
+        for (i = 0; i < report->field_num; i++)
+            report->field_list[i].byte += c->plan->numbered;
+    }
+
+    plan = c->plan;
+    c->plan = NULL;
+
+cleanup:
+    uhd_plan_free(c->plan);
+    free(c);
+    return plan;
+}
+
+
+uhd_plan *
+uhd_plan_ref(uhd_plan *plan)
+{
+    assert(plan != NULL);
+
+    __atomic_add_fetch(&plan->refs, 1, __ATOMIC_RELAXED);
+    return plan;
+}
+
+
+void
+uhd_plan_free(uhd_plan *plan)
+{
+    size_t  id;
+
+    if (plan == NULL ||
+        __atomic_sub_fetch(&plan->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    for (id = 0; id < 256; id++)
+        if (plan->report[id] != NULL)
+        {
+            free(plan->report[id]->field_list);
+            free(plan->report[id]);
+        }
+    free(plan->usage_list);
+    free(plan);
+}
+
+
+size_t
+uhd_plan_format(const uhd_plan *plan,
+                const uint8_t  *data,
+                size_t          len,
+                char           *buf,
+                size_t          size)
+{
+    const uhd_plan_report  *report;
+    const uhd_plan_field   *field;
+    int64_t                 v;
+    uint32_t                usage;
+    char                    name[UHD_PLAN_NAME_MAX];
+    size_t                  pos     = 0;
+    int                     rc;
+
+    assert(plan != NULL);
+    assert(data != NULL || len == 0);
+    assert(buf != NULL && size > 0);
+
+    buf[0] = '\0';
+
+    if (plan->numbered && len == 0)
+        return 0;
+    report = plan->report[plan->numbered ? data[0] : 0];
+    if (report == NULL || len < report->len)
+        return 0;
+
+    for (field = report->field_list;
+         field < report->field_list + report->field_num && pos < size - 1;
+         field++)
+    {
+        v = uhd_plan_field_value(field, data);
+
+        if (!field->array)
+            rc = snprintf(buf + pos, size - pos, "%s%s=%lld",
+                          pos > 0 ? " " : "", field->name, (long long)v);
+        else
+        {
+            /* Skip empty selections */
+            v -= field->logical_min;
+            if (v < 0 || v >= field->usage_num)
+                continue;
+            usage = plan->usage_list[field->usage_idx + v];
+            if ((usage & 0xffff) == 0)
+                continue;
+            usage_name(usage, name, sizeof(name));
+            rc = snprintf(buf + pos, size - pos, "%s%s=1",
+                          pos > 0 ? " " : "", name);
+        }
+
+        if (rc < 0)
+            break;
+        pos += rc;
+    }
+
+    return pos < size ? pos : size - 1;
+}
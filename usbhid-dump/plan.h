@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - report decoding plan
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_PLAN_H__
+#define __UHD_PLAN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a field name, including the terminating zero */
+#define UHD_PLAN_NAME_MAX   16
+
+/**
+ * Input report field extraction step.
+ *
+ * Everything needed to extract the field value is computed when the plan
+ * is compiled: the value is read as a little-endian integer of "span"
+ * bytes at "byte", shifted right by "shift" and masked with "mask".
+ */
+typedef struct uhd_plan_field uhd_plan_field;
+
+struct uhd_plan_field {
+    uint16_t    byte;                   /**< Offset of the first byte
+                                             holding the field, counting
+                                             the report ID byte, if any */
+    uint8_t     span;                   /**< Number of bytes holding the
+                                             field, 1-5 */
+    uint8_t     shift;                  /**< Bit offset in the first byte */
+    uint8_t     size;                   /**< Field size, bits, 1-32 */
+    bool        is_signed;              /**< True if the value is signed */
+    bool        array;                  /**< True if the value is an index
+                                             into the usage list, rather
+                                             than the usage value */
+    uint32_t    mask;                   /**< Value mask */
+    int32_t     logical_min;            /**< Logical minimum, the usage
+                                             list index base of arrays */
+    uint32_t    usage_idx;              /**< First usage in the plan usage
+                                             list */
+    uint32_t    usage_num;              /**< Number of usages, one for
+                                             variables */
+    char        name[UHD_PLAN_NAME_MAX];/**< Usage name of variables */
+};
+
+/** Input report extraction plan */
+typedef struct uhd_plan_report uhd_plan_report;
+
+struct uhd_plan_report {
+    size_t          len;                /**< Report length, bytes, counting
+                                             the report ID byte, if any */
+    size_t          field_num;          /**< Number of fields */
+    uhd_plan_field *field_list;         /**< Fields, in report order */
+};
+
+/**
+ * Report decoding plan, compiled from a report descriptor once, and used
+ * to decode every input report without walking the descriptor again.
+ */
+typedef struct uhd_plan uhd_plan;
+
+struct uhd_plan {
+    bool                numbered;           /**< True if the reports are
+                                                 prefixed with an ID */
+    uhd_plan_report    *report[256];        /**< Input reports by ID, zero
+                                                 for unnumbered ones */
+    uint32_t           *usage_list;         /**< Extended usages (page in
+                                                 the high 16 bits) of all
+                                                 array fields */
+    size_t              usage_num;          /**< Number of usages in the
+                                                 list */
+    unsigned int        refs;               /**< Reference count, reports
+                                                 queued for decoding on the
+                                                 writer thread hold one */
+};
+
+/**
+ * Compile a report descriptor into a decoding plan.
+ *
+ * @param rd    Report descriptor.
+ * @param len   Report descriptor length.
+ *
+ * @return The plan, or NULL if the descriptor is malformed or failed to
+ *         allocate memory.
+ */
+extern uhd_plan *uhd_plan_new(const uint8_t *rd, size_t len);
+
+/**
+ * Take a reference to a decoding plan.
+ *
+ * @param plan  The plan to reference.
+ *
+ * @return The plan.
+ */
+extern uhd_plan *uhd_plan_ref(uhd_plan *plan);
+
+/**
+ * Drop a reference to a decoding plan, freeing it with the last one.
+ *
+ * @param plan  The plan to free, could be NULL.
+ */
+extern void uhd_plan_free(uhd_plan *plan);
+
+/**
+ * Extract a field value from a report.
+ *
+ * @param field The field to extract.
+ * @param data  The report, at least the field's report length long.
+ *
+ * @return The field value, sign-extended if signed.
+ */
+static inline int64_t
+uhd_plan_field_value(const uhd_plan_field *field, const uint8_t *data)
+{
+    const uint8_t  *p   = data + field->byte;
+    uint64_t        v   = p[0];
+    uint32_t        u;
+
+    switch (field->span)
+    {
+        case 5: v |= (uint64_t)p[4] << 32;  /* fall through */
+        case 4: v |= (uint64_t)p[3] << 24;  /* fall through */
+        case 3: v |= (uint64_t)p[2] << 16;  /* fall through */
+        case 2: v |= (uint64_t)p[1] << 8;   /* fall through */
+        default: break;
+    }
+
+    u = (v >> field->shift) & field->mask;
+    if (field->is_signed && (u >> (field->size - 1)) != 0)
+        return (int64_t)u - ((int64_t)1 << field->size);
+    return u;
+}
+
+/**
+ * Decode an input report into "NAME=VALUE" pairs, separated by spaces.
+ * Variables are named after their usages, array fields are output as
+ * the selected usage, named the same way, with a value of 1.
+ *
+ * @param plan  The plan to decode with.
+ * @param data  The report.
+ * @param len   The report length.
+ * @param buf   Output buffer.
+ * @param size  Output buffer size.
+ *
+ * @return Length of the output, not counting the terminating zero, or
+ *         zero if the report has no plan, or is too short. Output is
+ *         truncated at the buffer size.
+ */
+extern size_t uhd_plan_format(const uhd_plan   *plan,
+                              const uint8_t    *data,
+                              size_t            len,
+                              char             *buf,
+                              size_t            size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_PLAN_H__ */
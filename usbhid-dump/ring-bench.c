@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - shared memory ring benchmark consumer
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "ring_reader.h"
+#include "stats.h"
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**< Number of the signal causing the exit */
+static volatile sig_atomic_t exit_signum = 0;
+
+static void
+exit_sighandler(int signum)
+{
+    if (exit_signum == 0)
+        exit_signum = signum;
+}
+
+static uint64_t
+clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+usage(FILE *stream, const char *name)
+{
+    return fprintf(stream,
+"Usage: %s [OPTION]... NAME\n"
+"Read records from a usbhid-dump shared memory ring NAME and report the\n"
+"delivery latency, the reader lag and the records lost.\n"
+"\n"
+"Options:\n"
+"  -h, --help                       output this help message and exit\n"
+"  -t, --time=NUMBER                stop after NUMBER seconds; zero means\n"
+"                                   when the producer exits (default)\n"
+"  -p, --poll=NUMBER                sleep NUMBER microseconds when there\n"
+"                                   are no records; zero means spin\n"
+"                                   (default 100)\n"
+"\n",
+                   name) >= 0;
+}
+
+static const struct option long_opt_list[] = {
+    {.val = 'h', .name = "help", .has_arg = no_argument, .flag = NULL},
+    {.val = 't', .name = "time", .has_arg = required_argument, .flag = NULL},
+    {.val = 'p', .name = "poll", .has_arg = required_argument, .flag = NULL},
+    {.val = 0, .name = NULL, .has_arg = 0, .flag = NULL}
+};
+
+static bool
+parse_number(const char *str, unsigned long *pn)
+{
+    char           *end;
+    unsigned long   n;
+
+    errno = 0;
+    n = strtoul(str, &end, 10);
+    if (*str == '\0' || *str == '-' || *end != '\0' || errno != 0)
+        return false;
+
+    *pn = n;
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char             *name;
+    int                     c;
+    unsigned long           time_s      = 0;
+    unsigned long           poll_us     = 100;
+    uhd_ring_reader        *reader;
+    const uhd_ring_header  *hdr;
+    uhd_stats              *latency;
+    const uint8_t          *rec;
+    size_t                  len;
+    uint64_t                start;
+    uint64_t                now;
+    uint64_t                lag;
+    uint64_t                max_lag     = 0;
+    uint64_t                count       = 0;
+    uint64_t                bytes       = 0;
+    uint64_t                ts;
+    struct timespec         pause;
+    struct sigaction        sa;
+
+    name = strrchr(argv[0], '/');
+    name = name == NULL ? argv[0] : name + 1;
+
+    while ((c = getopt_long(argc, argv, "ht:p:", long_opt_list, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'h':
+                usage(stdout, name);
+                return 0;
+            case 't':
+                if (!parse_number(optarg, &time_s))
+                {
+                    fprintf(stderr, "Invalid time \"%s\"\n", optarg);
+                    usage(stderr, name);
+                    return 1;
+                }
+                break;
+            case 'p':
+                if (!parse_number(optarg, &poll_us) || poll_us >= 1000000)
+                {
+                    fprintf(stderr, "Invalid poll interval \"%s\"\n", optarg);
+                    usage(stderr, name);
+                    return 1;
+                }
+                break;
+            default:
+                usage(stderr, name);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "A single ring name is required\n");
+        usage(stderr, name);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = exit_sighandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    reader = uhd_ring_reader_open(argv[optind]);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "%s: Failed to attach to ring \"%s\": %s\n",
+                name, argv[optind], strerror(errno));
+        return 1;
+    }
+    hdr = uhd_ring_reader_header(reader);
+
+    latency = uhd_stats_new();
+    if (latency == NULL)
+    {
+        fprintf(stderr, "%s: Failed to allocate statistics\n", name);
+        uhd_ring_reader_close(reader);
+        return 1;
+    }
+
+    pause.tv_sec = 0;
+    pause.tv_nsec = poll_us * 1000;
+    start = clock_ns(CLOCK_MONOTONIC);
+
+    while (exit_signum == 0)
+    {
+        lag = uhd_ring_reader_lag(reader);
+        if (lag > max_lag)
+            max_lag = lag;
+
+        rec = uhd_ring_reader_peek(reader, &len);
+        if (rec == NULL)
+        {
+            if (uhd_ring_reader_closed(reader))
+                break;
+            if (time_s > 0 &&
+                clock_ns(CLOCK_MONOTONIC) - start >= time_s * 1000000000)
+                break;
+            if (poll_us > 0)
+                nanosleep(&pause, NULL);
+            continue;
+        }
+
+        /* Read the timestamp in place, then check it's still there */
+        ts = len >= UHD_CAPTURE_RECORD_LEN ? uhd_capture_get_le(rec, 8) : 0;
+        now = clock_ns(CLOCK_MONOTONIC);
+        if (!uhd_ring_reader_next(reader))
+            continue;
+
+        count++;
+        bytes += len;
+        if (ts != 0 && now > ts)
+            uhd_stats_add_time(latency, now - ts);
+    }
+
+    now = clock_ns(CLOCK_MONOTONIC);
+    printf("producer %u, %u slots of %u bytes\n"
+           "%llu records, %llu bytes in %.3f s, %llu lost, max lag %llu\n"
+           "latency p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           hdr->pid, hdr->slot_num, hdr->slot_size,
+           (unsigned long long int)count, (unsigned long long int)bytes,
+           (now - start) / 1e9,
+           (unsigned long long int)uhd_ring_reader_lost(reader),
+           (unsigned long long int)max_lag,
+           uhd_stats_percentile(latency, 50) / 1e6,
+           uhd_stats_percentile(latency, 99) / 1e6,
+           latency->max / 1e6);
+
+    uhd_stats_free(latency);
+    uhd_ring_reader_close(reader);
+
+    return 0;
+}
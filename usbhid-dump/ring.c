@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - shared memory ring
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "ring.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+struct uhd_ring {
+    char               *name;       /**< Shared memory object name */
+    uhd_ring_header    *hdr;        /**< Mapped ring */
+    size_t              size;       /**< Mapping size, bytes */
+    uint64_t            head;       /**< Next record sequence number */
+    uhd_ring_slot      *slot;       /**< Reserved slot, NULL if none */
+};
+
+
+uhd_ring *
+uhd_ring_new(const char    *name,
+             uint32_t       slot_num,
+             uint64_t       realtime,
+             uint64_t       monotonic)
+{
+    uhd_ring           *ring;
+    uhd_ring_header    *hdr;
+    uint32_t            num;
+    int                 fd;
+    int                 saved_errno;
+
+    assert(name != NULL);
+    assert(slot_num > 0 && slot_num <= INT32_MAX);
+
+    for (num = 1; num < slot_num; num <<= 1);
+
+    ring = calloc(1, sizeof(*ring));
+    if (ring == NULL)
+        return NULL;
+
+    ring->name = malloc(strlen(name) + 2);
+    if (ring->name == NULL)
+        goto cleanup;
+    sprintf(ring->name, "%s%s", name[0] == '/' ? "" : "/", name);
+
+    ring->size = sizeof(uhd_ring_header) + (size_t)num * UHD_RING_SLOT_SIZE;
+
+    /*
+     * Replace, rather than truncate an existing ring, as readers still
+     * attached to it would be killed with SIGBUS
+     */
+    if (shm_unlink(ring->name) < 0 && errno != ENOENT)
+        goto cleanup;
+    fd = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        goto cleanup;
+    if (ftruncate(fd, ring->size) < 0)
+    {
+        saved_errno = errno;
+        close(fd);
+        shm_unlink(ring->name);
+        errno = saved_errno;
+        goto cleanup;
+    }
+    hdr = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    saved_errno = errno;
+    close(fd);
+    if (hdr == MAP_FAILED)
+    {
+        shm_unlink(ring->name);
+        errno = saved_errno;
+        goto cleanup;
+    }
+
+    /* The object is zeroed, so all the slots are empty already */
+    hdr->version        = UHD_RING_VERSION;
+    hdr->header_size    = sizeof(uhd_ring_header);
+    hdr->slot_size      = UHD_RING_SLOT_SIZE;
+    hdr->slot_num       = num;
+    hdr->realtime       = realtime;
+    hdr->monotonic      = monotonic;
+    hdr->pid            = getpid();
+    /* Readers check the magic last */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(hdr->magic, UHD_RING_MAGIC, sizeof(hdr->magic));
+
+    ring->hdr = hdr;
+    return ring;
+
+cleanup:
+    saved_errno = errno;
+    free(ring->name);
+    free(ring);
+    errno = saved_errno;
+    return NULL;
+}
+
+
+uint8_t *
+uhd_ring_reserve(uhd_ring *ring)
+{
+    assert(ring != NULL);
+    assert(ring->slot == NULL);
+
+    ring->slot = uhd_ring_slot_get(ring->hdr, ring->head);
+
+    /* Invalidate the overwritten record before touching it */
+    __atomic_store_n(&ring->slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return (uint8_t *)(ring->slot + 1);
+}
+
+
+void
+uhd_ring_commit(uhd_ring *ring, size_t len)
+{
+    assert(ring != NULL);
+    assert(ring->slot != NULL);
+    assert(len <= UHD_RING_DATA_MAX);
+
+    ring->slot->len = len;
+    ring->head++;
+    __atomic_store_n(&ring->slot->seq, ring->head, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->hdr->head, ring->head, __ATOMIC_RELEASE);
+    ring->slot = NULL;
+}
+
+
+void
+uhd_ring_free(uhd_ring *ring)
+{
+    if (ring == NULL)
+        return;
+
+    __atomic_store_n(&ring->hdr->closed, 1, __ATOMIC_RELEASE);
+    munmap(ring->hdr, ring->size);
+    shm_unlink(ring->name);
+    free(ring->name);
+    free(ring);
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - shared memory ring
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_RING_H__
+#define __UHD_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "capture.h"
+#include "misc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A shared memory ring is a POSIX shared memory object (a file in
+ * /dev/shm) holding a header followed by a power of two number of
+ * fixed-size slots. It has a single producer, usbhid-dump, and any number
+ * of readers, which attach and detach as they please, and never hold up
+ * the producer: a reader falling more than the slot number of records
+ * behind simply loses the overwritten ones.
+ *
+ * Every record gets a sequence number, starting from zero, and is stored
+ * in slot "sequence number modulo slot number", as a binary capture
+ * record (see capture.h). The header "head" is the sequence number of the
+ * next record to be published. A slot "seq" is the sequence number of the
+ * record it holds plus one, or zero while the record is being written, so
+ * readers can verify a record wasn't overwritten while they were reading
+ * it, in place, seqlock-style.
+ *
+ * All integers are in the host byte order and are accessed atomically
+ * where marked so.
+ */
+
+/** Shared memory ring magic */
+#define UHD_RING_MAGIC          "UHDRING\n"
+
+/** Shared memory ring layout version */
+#define UHD_RING_VERSION        1
+
+/** Slot size, bytes */
+#define UHD_RING_SLOT_SIZE      (UHD_MAX_DESCRIPTOR_SIZE + 64)
+
+/** Maximum record length, bytes */
+#define UHD_RING_DATA_MAX       (UHD_RING_SLOT_SIZE - \
+                                 sizeof(uhd_ring_slot))
+
+/** Default number of slots */
+#define UHD_RING_SLOT_NUM       1024
+
+/** Shared memory ring header */
+typedef struct uhd_ring_header uhd_ring_header;
+
+struct uhd_ring_header {
+    char        magic[8];       /**< UHD_RING_MAGIC */
+    uint32_t    version;        /**< UHD_RING_VERSION */
+    uint32_t    header_size;    /**< Header size, the first slot offset */
+    uint32_t    slot_size;      /**< Slot size, bytes */
+    uint32_t    slot_num;       /**< Number of slots, a power of two */
+    uint64_t    realtime;       /**< CLOCK_REALTIME at start, ns */
+    uint64_t    monotonic;      /**< CLOCK_MONOTONIC at start, ns */
+    uint32_t    pid;            /**< Producer process ID */
+    uint32_t    closed;         /**< Non-zero once the producer is done,
+                                     atomic */
+    uint8_t     pad1[16];
+    /* Kept on its own cache line, as the only field written per record */
+    uint64_t    head;           /**< Next record sequence number, atomic */
+    uint8_t     pad2[56];
+};
+
+/** Shared memory ring slot header, followed by the record */
+typedef struct uhd_ring_slot uhd_ring_slot;
+
+struct uhd_ring_slot {
+    uint64_t    seq;            /**< Record sequence number plus one, or
+                                     zero while written, atomic */
+    uint32_t    len;            /**< Record length, bytes */
+    uint32_t    reserved;
+};
+
+/**
+ * Locate a slot of a mapped shared memory ring.
+ *
+ * @param hdr   The ring header.
+ * @param seq   Sequence number of the record to locate the slot of.
+ *
+ * @return The slot.
+ */
+static inline uhd_ring_slot *
+uhd_ring_slot_get(const uhd_ring_header *hdr, uint64_t seq)
+{
+    return (uhd_ring_slot *)((uint8_t *)hdr + hdr->header_size +
+                             (size_t)(seq & (hdr->slot_num - 1)) *
+                                hdr->slot_size);
+}
+
+/** Shared memory ring producer */
+typedef struct uhd_ring uhd_ring;
+
+/**
+ * Create a shared memory ring, replacing an existing one with the same
+ * name. Readers attached to the replaced ring see it closed.
+ *
+ * @param name      Shared memory object name, with or without the leading
+ *                  slash.
+ * @param slot_num  Number of slots, rounded up to a power of two.
+ * @param realtime  CLOCK_REALTIME at start, ns.
+ * @param monotonic CLOCK_MONOTONIC at start, ns.
+ *
+ * @return The ring producer, or NULL with errno set, if failed.
+ */
+extern uhd_ring *uhd_ring_new(const char   *name,
+                              uint32_t      slot_num,
+                              uint64_t      realtime,
+                              uint64_t      monotonic);
+
+/**
+ * Reserve the slot for the next record. Must be followed by
+ * uhd_ring_commit() before the next reservation.
+ *
+ * @param ring  The ring to reserve the slot in.
+ *
+ * @return The slot record buffer, UHD_RING_DATA_MAX bytes.
+ */
+extern uint8_t *uhd_ring_reserve(uhd_ring *ring);
+
+/**
+ * Publish the record written into the reserved slot.
+ *
+ * @param ring  The ring to publish the record in.
+ * @param len   Record length, bytes, not more than UHD_RING_DATA_MAX.
+ */
+extern void uhd_ring_commit(uhd_ring *ring, size_t len);
+
+/**
+ * Mark a shared memory ring closed, remove its name and free the
+ * producer. Attached readers can still read the records left.
+ *
+ * @param ring  The ring to free, could be NULL.
+ */
+extern void uhd_ring_free(uhd_ring *ring);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_RING_H__ */
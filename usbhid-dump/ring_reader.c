@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - shared memory ring reader
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "ring_reader.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct uhd_ring_reader {
+    const uhd_ring_header  *hdr;    /**< Mapped ring */
+    size_t                  size;   /**< Mapping size, bytes */
+    uint64_t                seq;    /**< Next record sequence number */
+    bool                    peeked; /**< True if the next record was
+                                         peeked at */
+    uint64_t                lost;   /**< Number of lost records */
+};
+
+
+/**
+ * Check a mapped shared memory ring header is supported and consistent.
+ *
+ * @param hdr   The header to check.
+ * @param size  Mapping size.
+ *
+ * @return True if the header is valid, false otherwise.
+ */
+static bool
+uhd_ring_reader_valid(const uhd_ring_header *hdr, size_t size)
+{
+    if (size < sizeof(*hdr) ||
+        memcmp(hdr->magic, UHD_RING_MAGIC, sizeof(hdr->magic)) != 0)
+        return false;
+    /* The magic is written last */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return hdr->version == UHD_RING_VERSION &&
+           hdr->header_size >= sizeof(*hdr) &&
+           hdr->slot_size > sizeof(uhd_ring_slot) &&
+           hdr->slot_size % sizeof(uint64_t) == 0 &&
+           hdr->slot_num > 0 &&
+           (hdr->slot_num & (hdr->slot_num - 1)) == 0 &&
+           hdr->header_size +
+                (uint64_t)hdr->slot_num * hdr->slot_size <= size;
+}
+
+
+uhd_ring_reader *
+uhd_ring_reader_open(const char *name)
+{
+    uhd_ring_reader    *reader;
+    char               *path;
+    int                 fd;
+    struct stat         st;
+    void               *map;
+    int                 saved_errno;
+
+    assert(name != NULL);
+
+    path = malloc(strlen(name) + 2);
+    if (path == NULL)
+        return NULL;
+    sprintf(path, "%s%s", name[0] == '/' ? "" : "/", name);
+    fd = shm_open(path, O_RDONLY | O_CLOEXEC, 0);
+    saved_errno = errno;
+    free(path);
+    if (fd < 0)
+    {
+        errno = saved_errno;
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0)
+        goto cleanup_fd;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        goto cleanup_fd;
+    close(fd);
+
+    if (!uhd_ring_reader_valid(map, st.st_size))
+    {
+        munmap(map, st.st_size);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader == NULL)
+    {
+        saved_errno = errno;
+        munmap(map, st.st_size);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    reader->hdr     = map;
+    reader->size    = st.st_size;
+    reader->seq     = __atomic_load_n(&reader->hdr->head, __ATOMIC_ACQUIRE);
+
+    return reader;
+
+cleanup_fd:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return NULL;
+}
+
+
+const uhd_ring_header *
+uhd_ring_reader_header(const uhd_ring_reader *reader)
+{
+    assert(reader != NULL);
+    return reader->hdr;
+}
+
+
+const uint8_t *
+uhd_ring_reader_peek(uhd_ring_reader *reader, size_t *plen)
+{
+    const uhd_ring_header  *hdr;
+    const uhd_ring_slot    *slot;
+    uint64_t                head;
+    size_t                  len;
+
+    assert(reader != NULL);
+    assert(plen != NULL);
+
+    hdr = reader->hdr;
+    head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+
+    for (; reader->seq != head; reader->seq++, reader->lost++)
+    {
+        /* Skip the records overwritten already */
+        if (head - reader->seq > hdr->slot_num)
+        {
+            reader->lost += head - hdr->slot_num - reader->seq;
+            reader->seq = head - hdr->slot_num;
+        }
+
+        slot = uhd_ring_slot_get(hdr, reader->seq);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) ==
+                reader->seq + 1)
+        {
+            /* The length is only trusted once the record is verified */
+            len = slot->len;
+            if (len > hdr->slot_size - sizeof(*slot))
+                len = hdr->slot_size - sizeof(*slot);
+            *plen = len;
+            reader->peeked = true;
+            return (const uint8_t *)(slot + 1);
+        }
+
+        /* Overwritten after the head was read */
+        head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    }
+
+    return NULL;
+}
+
+
+bool
+uhd_ring_reader_next(uhd_ring_reader *reader)
+{
+    const uhd_ring_slot    *slot;
+    bool                    intact;
+
+    assert(reader != NULL);
+    assert(reader->peeked);
+
+    /* Make sure the record was read before checking it's still there */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    slot = uhd_ring_slot_get(reader->hdr, reader->seq);
+    intact = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) ==
+                reader->seq + 1;
+    if (!intact)
+        reader->lost++;
+
+    reader->seq++;
+    reader->peeked = false;
+
+    return intact;
+}
+
+
+bool
+uhd_ring_reader_closed(const uhd_ring_reader *reader)
+{
+    assert(reader != NULL);
+    return __atomic_load_n(&reader->hdr->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+
+uint64_t
+uhd_ring_reader_lag(const uhd_ring_reader *reader)
+{
+    assert(reader != NULL);
+    return __atomic_load_n(&reader->hdr->head, __ATOMIC_RELAXED) -
+           reader->seq;
+}
+
+
+uint64_t
+uhd_ring_reader_lost(const uhd_ring_reader *reader)
+{
+    assert(reader != NULL);
+    return reader->lost;
+}
+
+
+void
+uhd_ring_reader_close(uhd_ring_reader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    munmap((void *)reader->hdr, reader->size);
+    free(reader);
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - shared memory ring reader
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_RING_READER_H__
+#define __UHD_RING_READER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared memory ring reader.
+ *
+ * Records are read in place: uhd_ring_reader_peek() returns a pointer
+ * into the ring, which stays usable until uhd_ring_reader_next() confirms
+ * the record wasn't overwritten meanwhile, and moves on to the next one.
+ * Records overwritten before they were read, or while being read, are
+ * counted as lost.
+ */
+typedef struct uhd_ring_reader uhd_ring_reader;
+
+/**
+ * Attach to a shared memory ring, positioning at its head, so only the
+ * records published from now on are read.
+ *
+ * @param name  Shared memory object name, with or without the leading
+ *              slash.
+ *
+ * @return The reader, or NULL with errno set, if failed. EPROTO means
+ *         the object isn't a supported ring.
+ */
+extern uhd_ring_reader *uhd_ring_reader_open(const char *name);
+
+/**
+ * Retrieve the header of the ring a reader is attached to, e.g. to
+ * convert record timestamps to wall-clock time.
+ *
+ * @param reader    The reader.
+ *
+ * @return The ring header.
+ */
+extern const uhd_ring_header *uhd_ring_reader_header(
+                                        const uhd_ring_reader *reader);
+
+/**
+ * Peek at the next record, without waiting.
+ *
+ * @param reader    The reader.
+ * @param plen      Location for the record length.
+ *
+ * @return The record, a binary capture record header followed by data, or
+ *         NULL if there are no records to read yet.
+ */
+extern const uint8_t *uhd_ring_reader_peek(uhd_ring_reader *reader,
+                                           size_t          *plen);
+
+/**
+ * Finish with the peeked record and move on to the next one.
+ *
+ * @param reader    The reader.
+ *
+ * @return True if the peeked record is intact, false if it was
+ *         overwritten while in use, and was counted as lost.
+ */
+extern bool uhd_ring_reader_next(uhd_ring_reader *reader);
+
+/**
+ * Check if the producer of a reader's ring is done.
+ *
+ * @param reader    The reader.
+ *
+ * @return True if no more records will be published.
+ */
+extern bool uhd_ring_reader_closed(const uhd_ring_reader *reader);
+
+/**
+ * Retrieve the number of records published, but not read by a reader yet.
+ *
+ * @param reader    The reader.
+ *
+ * @return The number of records.
+ */
+extern uint64_t uhd_ring_reader_lag(const uhd_ring_reader *reader);
+
+/**
+ * Retrieve the number of records a reader has lost so far.
+ *
+ * @param reader    The reader.
+ *
+ * @return The number of records.
+ */
+extern uint64_t uhd_ring_reader_lost(const uhd_ring_reader *reader);
+
+/**
+ * Detach a reader from its ring and free it.
+ *
+ * @param reader    The reader to free, could be NULL.
+ */
+extern void uhd_ring_reader_close(uhd_ring_reader *reader);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_RING_READER_H__ */
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - stream statistics
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "stats.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#define SUB_NUM (1u << UHD_STATS_SUB_BITS)
+
+static unsigned int
+bucket_index(uint64_t v)
+{
+    unsigned int    msb;
+
+    if (v < SUB_NUM)
+        return v;
+
+    msb = 63 - __builtin_clzll(v);
+    return (msb - UHD_STATS_SUB_BITS + 1) * SUB_NUM +
+           ((v >> (msb - UHD_STATS_SUB_BITS)) & (SUB_NUM - 1));
+}
+
+static uint64_t
+bucket_highest(unsigned int idx)
+{
+    unsigned int    shift;
+
+    if (idx < SUB_NUM)
+        return idx;
+
+    shift = idx / SUB_NUM - 1;
+    return ((((uint64_t)SUB_NUM + idx % SUB_NUM) << shift) - 1) +
+           ((uint64_t)1 << shift);
+}
+
+
+uhd_stats *
+uhd_stats_new(void)
+{
+    return calloc(1, sizeof(uhd_stats));
+}
+
+
+void
+uhd_stats_free(uhd_stats *stats)
+{
+    free(stats);
+}
+
+
+void
+uhd_stats_add(uhd_stats *stats, uint64_t ts)
+{
+    uint64_t    delta;
+
+    assert(stats != NULL);
+
+    if (stats->count++ == 0)
+    {
+        stats->first = stats->last = ts;
+        return;
+    }
+
+    delta = ts - stats->last;
+    stats->last = ts;
+    uhd_stats_add_time(stats, delta);
+}
+
+
+void
+uhd_stats_add_time(uhd_stats *stats, uint64_t t)
+{
+    assert(stats != NULL);
+
+    stats->bucket[bucket_index(t)]++;
+    if (t > stats->max)
+        stats->max = t;
+}
+
+
+uint64_t
+uhd_stats_percentile(const uhd_stats *stats, double p)
+{
+    uint64_t        total   = 0;
+    uint64_t        target;
+    uint64_t        sum     = 0;
+    unsigned int    idx;
+
+    assert(stats != NULL);
+
+    for (idx = 0; idx < UHD_STATS_BUCKET_NUM; idx++)
+        total += stats->bucket[idx];
+    if (total == 0)
+        return 0;
+
+    target = (uint64_t)(total * p / 100 + 0.5);
+    if (target < 1)
+        target = 1;
+
+    for (idx = 0; idx < UHD_STATS_BUCKET_NUM; idx++)
+    {
+        sum += stats->bucket[idx];
+        if (sum >= target)
+            break;
+    }
+
+    /* Don't report more than was actually seen */
+    return bucket_highest(idx) < stats->max ? bucket_highest(idx)
+                                            : stats->max;
+}
+
+
+bool
+uhd_stats_print(FILE *stream, const char *name, const uhd_stats *stats)
+{
+    double  rate    = 0;
+
+    assert(stats != NULL);
+
+    if (stats->count > 1 && stats->last > stats->first)
+        rate = (stats->count - 1) * 1e9 / (stats->last - stats->first);
+
+    return fprintf(stream,
+                   "%s: %llu reports, %.1f Hz, inter-arrival "
+                   "p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                   name, (unsigned long long int)stats->count, rate,
+                   uhd_stats_percentile(stats, 50) / 1e6,
+                   uhd_stats_percentile(stats, 99) / 1e6,
+                   stats->max / 1e6) >= 0;
+}
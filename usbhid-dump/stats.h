@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - stream statistics
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_STATS_H__
+#define __UHD_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of histogram sub-bucket bits: every power-of-two range of
+ * inter-arrival times is split into 2^UHD_STATS_SUB_BITS linear buckets,
+ * giving a relative error of at most 1/2^UHD_STATS_SUB_BITS.
+ */
+#define UHD_STATS_SUB_BITS      4
+
+/** Number of histogram buckets, covering the whole 64-bit range */
+#define UHD_STATS_BUCKET_NUM    ((64 - UHD_STATS_SUB_BITS + 1) << \
+                                 UHD_STATS_SUB_BITS)
+
+/** usbhid-dump stream statistics */
+typedef struct uhd_stats uhd_stats;
+
+struct uhd_stats {
+    uint64_t    count;                  /**< Number of reports */
+    uint64_t    first;                  /**< First report timestamp, ns */
+    uint64_t    last;                   /**< Last report timestamp, ns */
+    uint64_t    max;                    /**< Maximum inter-arrival time,
+                                             ns */
+    uint64_t    bucket[UHD_STATS_BUCKET_NUM];   /**< Inter-arrival time
+                                                     histogram */
+};
+
+/**
+ * Create new, empty stream statistics.
+ *
+ * @return New statistics, or NULL if failed to allocate.
+ */
+extern uhd_stats *uhd_stats_new(void);
+
+/**
+ * Free stream statistics.
+ *
+ * @param stats The statistics to free, could be NULL.
+ */
+extern void uhd_stats_free(uhd_stats *stats);
+
+/**
+ * Account a report in stream statistics.
+ *
+ * @param stats The statistics to update.
+ * @param ts    Report arrival timestamp, CLOCK_MONOTONIC ns.
+ */
+extern void uhd_stats_add(uhd_stats *stats, uint64_t ts);
+
+/**
+ * Account a time other than an inter-arrival one, e.g. a latency, in the
+ * histogram of stream statistics, without counting a report.
+ *
+ * @param stats The statistics to update.
+ * @param t     The time, ns.
+ */
+extern void uhd_stats_add_time(uhd_stats *stats, uint64_t t);
+
+/**
+ * Calculate a percentile of the times in the histogram.
+ *
+ * @param stats The statistics to calculate the percentile for.
+ * @param p     The percentile, 0-100.
+ *
+ * @return The highest time equivalent to the percentile bucket, ns, or
+ *         zero if there are no times recorded.
+ */
+extern uint64_t uhd_stats_percentile(const uhd_stats *stats, double p);
+
+/**
+ * Print a one-line summary of stream statistics.
+ *
+ * @param stream    The stream to print to.
+ * @param name      The name to prefix the line with.
+ * @param stats     The statistics to print.
+ *
+ * @return True if printed successfully, false otherwise.
+ */
+extern bool uhd_stats_print(FILE               *stream,
+                            const char         *name,
+                            const uhd_stats    *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_STATS_H__ */
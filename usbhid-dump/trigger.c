@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - pre-trigger capture triggers
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "trigger.h"
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Parse a decimal number.
+ *
+ * @param str   The string to parse.
+ * @param pend  Location for the pointer to the character after the
+ *              number.
+ * @param max   Maximum value.
+ * @param pn    Location for the number.
+ *
+ * @return True if parsed, false otherwise.
+ */
+static bool
+uhd_trigger_parse_number(const char        *str,
+                         const char       **pend,
+                         unsigned long      max,
+                         unsigned long     *pn)
+{
+    char           *end;
+    unsigned long   n;
+
+    if (!isdigit((int)*str))
+        return false;
+
+    errno = 0;
+    n = strtoul(str, &end, 10);
+    if (errno != 0 || n > max)
+        return false;
+
+    *pend = end;
+    *pn = n;
+    return true;
+}
+
+
+static int
+uhd_trigger_xdigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower((int)c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+
+bool
+uhd_trigger_parse(const char *str, uhd_trigger **plist)
+{
+    uhd_trigger    *trigger;
+    const char     *p;
+    unsigned long   n;
+    int             hi;
+    int             lo;
+    char           *d;
+
+    assert(str != NULL);
+    assert(plist != NULL);
+
+    trigger = calloc(1, sizeof(*trigger));
+    if (trigger == NULL)
+        return false;
+
+    if (strncmp(str, "bytes=", 6) == 0)
+    {
+        trigger->type = UHD_TRIGGER_TYPE_BYTES;
+        trigger->offset = -1;
+        for (p = str + 6;
+             (hi = uhd_trigger_xdigit(p[0])) >= 0 &&
+             (lo = uhd_trigger_xdigit(p[1])) >= 0;
+             p += 2)
+        {
+            if (trigger->len >= sizeof(trigger->bytes))
+                goto fail;
+            trigger->bytes[trigger->len++] = (hi << 4) | lo;
+        }
+        if (trigger->len == 0)
+            goto fail;
+        if (*p == '@')
+        {
+            if (!uhd_trigger_parse_number(p + 1, &p, 65535, &n))
+                goto fail;
+            trigger->offset = n;
+        }
+        if (*p != '\0')
+            goto fail;
+
+        d = trigger->desc + sprintf(trigger->desc, "bytes ");
+        for (n = 0; n < trigger->len; n++)
+            d += sprintf(d, "%.2X", trigger->bytes[n]);
+        if (trigger->offset >= 0)
+            sprintf(d, " at %ld", trigger->offset);
+    }
+    else if (strncmp(str, "id=", 3) == 0)
+    {
+        trigger->type = UHD_TRIGGER_TYPE_ID;
+        if (!uhd_trigger_parse_number(str + 3, &p, 255, &n) ||
+            n == 0 || *p != '\0')
+            goto fail;
+        trigger->id = n;
+        snprintf(trigger->desc, sizeof(trigger->desc),
+                 "report ID %lu", n);
+    }
+    else if (strncmp(str, "gap=", 4) == 0)
+    {
+        trigger->type = UHD_TRIGGER_TYPE_GAP;
+        if (!uhd_trigger_parse_number(str + 4, &p, 86400000, &n) ||
+            n == 0 || *p != '\0')
+            goto fail;
+        trigger->gap = (uint64_t)n * 1000000;
+        snprintf(trigger->desc, sizeof(trigger->desc),
+                 "gap over %lu ms", n);
+    }
+    else
+        goto fail;
+
+    /* Append, to match in the order specified */
+    while (*plist != NULL)
+        plist = &(*plist)->next;
+    *plist = trigger;
+
+    return true;
+
+fail:
+    free(trigger);
+    return false;
+}
+
+
+/**
+ * Check if a trigger matches a report.
+ *
+ * @param trigger   The trigger to check.
+ * @param data      Report data.
+ * @param len       Report length.
+ * @param gap       Time since the previous report, ns, zero if none.
+ *
+ * @return True if the trigger matches, false otherwise.
+ */
+static bool
+uhd_trigger_match(const uhd_trigger    *trigger,
+                  const uint8_t        *data,
+                  size_t                len,
+                  uint64_t              gap)
+{
+    const uint8_t  *p;
+
+    switch (trigger->type)
+    {
+        case UHD_TRIGGER_TYPE_BYTES:
+            if (trigger->offset >= 0)
+                return (size_t)trigger->offset + trigger->len <= len &&
+                       memcmp(data + trigger->offset, trigger->bytes,
+                              trigger->len) == 0;
+            for (p = data; p + trigger->len <= data + len; p++)
+                if (memcmp(p, trigger->bytes, trigger->len) == 0)
+                    return true;
+            return false;
+        case UHD_TRIGGER_TYPE_ID:
+            return len > 0 && data[0] == trigger->id;
+        case UHD_TRIGGER_TYPE_GAP:
+            return gap > trigger->gap;
+    }
+
+    return false;
+}
+
+
+const uhd_trigger *
+uhd_trigger_list_match(const uhd_trigger  *list,
+                       const uint8_t      *data,
+                       size_t              len,
+                       uint64_t            gap)
+{
+    for (; list != NULL; list = list->next)
+        if (uhd_trigger_match(list, data, len, gap))
+            return list;
+
+    return NULL;
+}
+
+
+void
+uhd_trigger_list_free(uhd_trigger *list)
+{
+    uhd_trigger    *next;
+
+    for (; list != NULL; list = next)
+    {
+        next = list->next;
+        free(list);
+    }
+}
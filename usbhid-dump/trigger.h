@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - pre-trigger capture triggers
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_TRIGGER_H__
+#define __UHD_TRIGGER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a trigger byte pattern */
+#define UHD_TRIGGER_BYTES_MAX   64
+
+/** Maximum length of a trigger description, including terminating zero */
+#define UHD_TRIGGER_DESC_MAX    (UHD_TRIGGER_BYTES_MAX * 2 + 32)
+
+/** Trigger type */
+typedef enum uhd_trigger_type {
+    UHD_TRIGGER_TYPE_BYTES, /**< Byte pattern in a report */
+    UHD_TRIGGER_TYPE_ID,    /**< Report ID */
+    UHD_TRIGGER_TYPE_GAP,   /**< Gap between reports over a threshold */
+} uhd_trigger_type;
+
+/** Pre-trigger capture trigger, a list member */
+typedef struct uhd_trigger uhd_trigger;
+
+struct uhd_trigger {
+    uhd_trigger        *next;                   /**< Next trigger */
+    uhd_trigger_type    type;                   /**< Trigger type */
+    uint8_t             bytes[UHD_TRIGGER_BYTES_MAX];
+                                                /**< Byte pattern */
+    size_t              len;                    /**< Byte pattern length */
+    long                offset;                 /**< Byte pattern offset,
+                                                     or -1 for any */
+    uint8_t             id;                     /**< Report ID */
+    uint64_t            gap;                    /**< Gap threshold, ns */
+    char                desc[UHD_TRIGGER_DESC_MAX];
+                                                /**< Description */
+};
+
+/**
+ * Parse a trigger specification and append the trigger to a list. The
+ * specification is one of:
+ *
+ *   bytes=HEX[@OFFSET] - a report contains the hex bytes, at the decimal
+ *                        byte offset, if specified, or anywhere otherwise
+ *   id=NUMBER          - a report starts with the report ID (1-255)
+ *   gap=NUMBER         - a report arrives more than NUMBER ms after the
+ *                        previous one from the same interface
+ *
+ * @param str   The specification to parse.
+ * @param plist Location of the list head pointer.
+ *
+ * @return True if parsed and appended, false if the specification is
+ *         invalid, or failed to allocate memory.
+ */
+extern bool uhd_trigger_parse(const char *str, uhd_trigger **plist);
+
+/**
+ * Find the first trigger in a list matching a report.
+ *
+ * @param list  The trigger list.
+ * @param data  Report data.
+ * @param len   Report length.
+ * @param gap   Time since the previous report from the same interface,
+ *              ns, zero if none.
+ *
+ * @return The matching trigger, or NULL if none matched.
+ */
+extern const uhd_trigger *uhd_trigger_list_match(const uhd_trigger *list,
+                                                 const uint8_t     *data,
+                                                 size_t             len,
+                                                 uint64_t           gap);
+
+/**
+ * Free a trigger list.
+ *
+ * @param list  The list to free, could be NULL.
+ */
+extern void uhd_trigger_list_free(uhd_trigger *list);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_TRIGGER_H__ */
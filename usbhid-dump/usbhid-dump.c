@@ -6,6 +6,13 @@
  */
 
 #include "iface_list.h"
+#include "writer.h"
+#include "capture.h"
+#include "plan.h"
+#include "loop.h"
+#include "ring.h"
+#include "trigger.h"
+#include "latency.h"
 #include "misc.h"
 #include <libusb.h>
 
@@ -21,6 +28,7 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <time.h>
 
 /* Define LIBUSB_CALL for libusb <= 1.0.8 */
 #ifndef LIBUSB_CALL
@@ -83,6 +91,9 @@
             LIBUSB_IFACE_FAILURE_CLEANUP(_iface, _fmt, ##_args);    \
     } while (0)
 
+/**< Event loop, woken up by the signal handlers */
+static uhd_loop *loop = NULL;
+
 /**< Number of the signal causing the exit */
 static volatile sig_atomic_t exit_signum  = 0;
 
@@ -91,6 +102,7 @@ exit_sighandler(int signum)
 {
     if (exit_signum == 0)
         exit_signum = signum;
+    uhd_loop_wake(loop);
 }
 
 /**< "Stream paused" flag - non-zero if paused */
@@ -113,374 +125,2254 @@ stream_resume_sighandler(int signum)
 /**< "Stream feedback" flag - non-zero if feedback is enabled */
 static volatile sig_atomic_t stream_feedback = 0;
 
+/**< "Statistics requested" flag - non-zero if should be printed */
+static volatile sig_atomic_t stats_requested = 0;
+
 static void
-dump(const uhd_iface   *iface,
-     const char        *entity,
-     const uint8_t     *ptr,
-     size_t             len)
+stats_sighandler(int signum)
+{
+    (void)signum;
+    stats_requested = 1;
+    uhd_loop_wake(loop);
+}
+
+/**< "Trigger requested" flag - non-zero if the history should be dumped */
+static volatile sig_atomic_t trigger_requested = 0;
+
+static void
+trigger_sighandler(int signum)
+{
+    (void)signum;
+    trigger_requested = 1;
+    uhd_loop_wake(loop);
+}
+
+/**< Number of stream transfers in flight, for all interfaces */
+static unsigned int inflight = 0;
+
+/**< "Retire pending" flag - true if an interface may need retiring */
+static bool retire_pending = false;
+
+/**
+ * "Stream restart" flag - true if interface streams should be kept going
+ * through transfer timeouts and failures, as long as the device is there
+ */
+static bool stream_restart = false;
+
+/** Maximum number of stream restarts without a report in between */
+#define STREAM_RESTART_MAX  8
+
+/**< CLOCK_REALTIME minus CLOCK_MONOTONIC at start, ns */
+static uint64_t realtime_offset = 0;
+
+/**< Output writer */
+static uhd_writer *writer = NULL;
+
+/**< Shared memory ring to output to instead, if any */
+static uhd_ring *ring = NULL;
+
+/** Output format */
+typedef enum dump_format {
+    DUMP_FORMAT_TEXT,   /**< Hex text */
+    DUMP_FORMAT_BINARY, /**< Binary capture, see capture.h */
+} dump_format;
+
+/**< Output format */
+static dump_format format = DUMP_FORMAT_TEXT;
+
+/**< "Decode" flag - true if stream reports should be decoded */
+static bool decode = false;
+
+/**< "Changes only" flag - true if duplicate reports should be suppressed */
+static bool changes_only = false;
+
+/**< Period of suppressed duplicate summaries, s, zero for none */
+static unsigned int changes_period = 0;
+
+/**< Pre-trigger period, ns, zero if reports are dumped directly */
+static uint64_t pretrigger = 0;
+
+/**< Pre-trigger capture triggers, besides the signal */
+static uhd_trigger *trigger_list = NULL;
+
+/**< Trigger timestamp, CLOCK_MONOTONIC ns, zero if not known */
+static uint64_t trigger_ts = 0;
+
+/**< Latency probe template, or NULL if not measuring round-trip latency */
+static uhd_latency *latency = NULL;
+
+/**< Latency probe period, ns */
+static uint64_t latency_period = 100000000;
+
+/** Maximum length of a dump chunk header line */
+#define DUMP_HEADER_MAX 64
+
+/** Maximum length of a decoded report line */
+#define DUMP_DECODE_MAX 4096
+
+/** Growable chunk formatting buffer */
+typedef struct dump_buffer {
+    uint8_t    *ptr;    /**< Buffer, or NULL if not allocated yet */
+    size_t      size;   /**< Buffer size */
+} dump_buffer;
+
+/**< Chunk formatting buffer of the thread dumping the chunks */
+static dump_buffer dump_chunk_buf = {NULL, 0};
+
+/**< Text formatting buffer of the output writer thread */
+static dump_buffer dump_text_buf = {NULL, 0};
+
+/**
+ * Get a formatting buffer, growing it as needed.
+ *
+ * @param buf   The buffer to get.
+ * @param need  Minimum buffer size.
+ *
+ * @return The buffer, or NULL if failed to allocate.
+ */
+static uint8_t *
+dump_buf(dump_buffer *buf, size_t need)
+{
+    uint8_t    *p;
+
+    if (need > buf->size)
+    {
+        p = realloc(buf->ptr, need);
+        if (p == NULL)
+        {
+            GENERIC_FAILURE("allocate %zu bytes for a dump chunk", need);
+            return NULL;
+        }
+        buf->ptr = p;
+        buf->size = need;
+    }
+
+    return buf->ptr;
+}
+
+static uint64_t
+clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Format a chunk in the text format.
+ *
+ * @param addr_str  Interface address string.
+ * @param entity    Chunk entity name.
+ * @param sec       Timestamp seconds.
+ * @param usec      Timestamp microseconds.
+ * @param plan      Plan to decode the chunk with, or NULL to not decode.
+ * @param ptr       Chunk data.
+ * @param len       Chunk length.
+ * @param pout      Location for the formatted text, which stays valid
+ *                  until the next call.
+ *
+ * @return Formatted text length, zero if failed.
+ */
+static size_t
+dump_text(const char           *addr_str,
+          const char           *entity,
+          unsigned long long    sec,
+          unsigned int          usec,
+          const uhd_plan       *plan,
+          const uint8_t        *ptr,
+          size_t                len,
+          const void          **pout)
 {
+    const uint8_t      *data    = ptr;
+    size_t              n;
     static const char   xd[]    = "0123456789ABCDEF";
-    static char         buf[]   = " XX\n";
+    char               *buf;
+    char               *p;
+    int                 rc;
     size_t              pos;
     uint8_t             b;
-    struct timeval      tv;
 
-    gettimeofday(&tv, NULL);
+    /* Header, three characters per byte, line breaks and separator */
+    buf = (char *)dump_buf(&dump_text_buf,
+                           DUMP_HEADER_MAX + len * 3 + len / 16 + 2 +
+                           (plan != NULL ? DUMP_DECODE_MAX + 2 : 0));
+    if (buf == NULL)
+        return 0;
 
-    fprintf(stdout, "%s:%-16s %12llu.%.6u\n",
-            iface->addr_str, entity,
-            (unsigned long long int)tv.tv_sec,
-            (unsigned int)tv.tv_usec);
+    rc = snprintf(buf, DUMP_HEADER_MAX, "%s:%-16s %12llu.%.6u\n",
+                  addr_str, entity, sec, usec);
+    if (rc < 0)
+        return 0;
+    p = buf + (rc < DUMP_HEADER_MAX ? rc : DUMP_HEADER_MAX - 1);
 
     for (pos = 1; len > 0; len--, ptr++, pos++)
     {
         b = *ptr;
-        buf[1] = xd[b >> 4];
-        buf[2] = xd[b & 0xF];
-
-        (void)fwrite(buf, ((pos % 16 == 0) ? 4 : 3), 1, stdout);
+        *p++ = ' ';
+        *p++ = xd[b >> 4];
+        *p++ = xd[b & 0xF];
+        if (pos % 16 == 0)
+            *p++ = '\n';
     }
 
     if (pos % 16 != 1)
-        fputc('\n', stdout);
-    fputc('\n', stdout);
+        *p++ = '\n';
+
+    /* Add the decoded report line, if there is a plan for it */
+    if (plan != NULL)
+    {
+        *p = ' ';
+        n = uhd_plan_format(plan, data, ptr - data, p + 1, DUMP_DECODE_MAX);
+        if (n > 0)
+        {
+            p += 1 + n;
+            *p++ = '\n';
+        }
+    }
 
-    fflush(stdout);
+    *p++ = '\n';
+
+    *pout = buf;
+    return p - buf;
 }
 
+/**
+ * Format a chunk as a binary capture record.
+ *
+ * @param buf   Output buffer, UHD_CAPTURE_RECORD_LEN + len bytes.
+ * @param iface The interface the chunk came from.
+ * @param type  Chunk type.
+ * @param ts    Chunk timestamp, CLOCK_MONOTONIC ns.
+ * @param ptr   Chunk data.
+ * @param len   Chunk length.
+ */
+static void
+dump_record(uint8_t            *buf,
+            const uhd_iface    *iface,
+            uhd_capture_type    type,
+            uint64_t            ts,
+            const uint8_t      *ptr,
+            size_t              len)
+{
+    libusb_device  *lusb_dev    = libusb_get_device(iface->dev->handle);
+
+    uhd_capture_record(buf, ts, len, type,
+                       libusb_get_bus_number(lusb_dev),
+                       libusb_get_device_address(lusb_dev),
+                       iface->number,
+                       type == UHD_CAPTURE_TYPE_STREAM
+                            ? iface->int_in_ep_addr
+                            : type == UHD_CAPTURE_TYPE_OUTPUT
+                                ? iface->int_out_ep_addr
+                                : 0);
+    memcpy(buf + UHD_CAPTURE_RECORD_LEN, ptr, len);
+}
 
-static bool
-dump_iface_list_descriptor(const uhd_iface *list)
+static void
+dump_binary(const uhd_iface    *iface,
+            uhd_capture_type    type,
+            uint64_t            ts,
+            const uint8_t      *ptr,
+            size_t              len)
 {
-    const uhd_iface    *iface;
-    uint8_t             buf[UHD_MAX_DESCRIPTOR_SIZE] = {0};
-    int                 rc;
-    enum libusb_error   err;
+    uint8_t        *buf;
 
-    UHD_IFACE_LIST_FOR_EACH(iface, list)
+    buf = dump_buf(&dump_chunk_buf, UHD_CAPTURE_RECORD_LEN + len);
+    if (buf == NULL)
+        return;
+
+    dump_record(buf, iface, type, ts, ptr, len);
+    uhd_writer_put(writer, buf, UHD_CAPTURE_RECORD_LEN + len);
+}
+
+static void
+dump_ring(const uhd_iface  *iface,
+          uhd_capture_type  type,
+          uint64_t          ts,
+          const uint8_t    *ptr,
+          size_t            len)
+{
+    /* Descriptors and reports always fit, but just in case */
+    if (len > UHD_RING_DATA_MAX - UHD_CAPTURE_RECORD_LEN)
+        len = UHD_RING_DATA_MAX - UHD_CAPTURE_RECORD_LEN;
+
+    /* Format the record in place */
+    dump_record(uhd_ring_reserve(ring), iface, type, ts, ptr, len);
+    uhd_ring_commit(ring, UHD_CAPTURE_RECORD_LEN + len);
+}
+
+static const char *
+dump_entity(uhd_capture_type type)
+{
+    switch (type)
+    {
+        case UHD_CAPTURE_TYPE_DESCRIPTOR:
+            return "DESCRIPTOR";
+        case UHD_CAPTURE_TYPE_OUTPUT:
+            return "OUTPUT";
+        default:
+            return "STREAM";
+    }
+}
+
+/**
+ * Text output frame, queued to the output writer thread in front of a
+ * binary capture record, for the writer thread to format it.
+ */
+typedef struct dump_frame {
+    uhd_plan   *plan;   /**< Plan to decode the record with, referenced,
+                             or NULL to not decode */
+    uint64_t    offset; /**< Offset turning the record timestamp into
+                             wall-clock time, ns */
+} dump_frame;
+
+/**
+ * Queue a text output frame to the output writer, dropping the frame plan
+ * reference if the frame is dropped.
+ *
+ * @param frame The frame.
+ * @param buf   Buffer with the capture record following the space for the
+ *              frame.
+ * @param len   Capture record data length.
+ */
+static void
+dump_frame_put(const dump_frame *frame, uint8_t *buf, size_t len)
+{
+    memcpy(buf, frame, sizeof(*frame));
+    if (!uhd_writer_put(writer, buf,
+                        sizeof(*frame) + UHD_CAPTURE_RECORD_LEN + len))
+        uhd_plan_free(frame->plan);
+}
+
+/**
+ * Format a text output frame, called by the output writer thread.
+ *
+ * @param rec   The frame followed by the capture record.
+ * @param len   Frame and record length.
+ * @param data  Unused.
+ * @param pout  Location for the formatted text.
+ *
+ * @return Formatted text length.
+ */
+static size_t
+dump_frame_format(const uint8_t *rec, size_t len, void *data,
+                  const void **pout)
+{
+    dump_frame  frame;
+    char        addr_str[12];
+    uint64_t    ts;
+    size_t      n;
+
+    (void)data;
+    assert(len >= sizeof(frame) + UHD_CAPTURE_RECORD_LEN);
+
+    memcpy(&frame, rec, sizeof(frame));
+    rec += sizeof(frame);
+    len -= sizeof(frame) + UHD_CAPTURE_RECORD_LEN;
+
+    ts = uhd_capture_get_le(rec, 8) + frame.offset;
+    snprintf(addr_str, sizeof(addr_str), "%.3hhu:%.3hhu:%.3hhu",
+             rec[13], rec[14], rec[15]);
+    n = dump_text(addr_str, dump_entity(rec[12]),
+                  ts / 1000000000, (ts % 1000000000) / 1000,
+                  frame.plan, rec + UHD_CAPTURE_RECORD_LEN, len, pout);
+
+    uhd_plan_free(frame.plan);
+    return n;
+}
+
+/**
+ * Dump a chunk.
+ *
+ * @param iface The interface the chunk came from.
+ * @param type  Chunk type.
+ * @param ts    Chunk timestamp, CLOCK_MONOTONIC ns.
+ * @param ptr   Chunk data.
+ * @param len   Chunk length.
+ */
+static void
+dump(const uhd_iface   *iface,
+     uhd_capture_type   type,
+     uint64_t           ts,
+     const uint8_t     *ptr,
+     size_t             len)
+{
+    dump_frame  frame;
+    uint8_t    *buf;
+
+    if (ring != NULL)
+    {
+        dump_ring(iface, type, ts, ptr, len);
+        return;
+    }
+
+    if (format == DUMP_FORMAT_BINARY)
+    {
+        dump_binary(iface, type, ts, ptr, len);
+        return;
+    }
+
+    /*
+     * Leave the formatting and decoding to the writer thread, holding
+     * on to the plan until then. Text output has always had wall-clock
+     * timestamps.
+     */
+    buf = dump_buf(&dump_chunk_buf,
+                   sizeof(frame) + UHD_CAPTURE_RECORD_LEN + len);
+    if (buf == NULL)
+        return;
+    frame.plan = type == UHD_CAPTURE_TYPE_STREAM && decode &&
+                 iface->plan != NULL
+                    ? uhd_plan_ref(iface->plan)
+                    : NULL;
+    frame.offset = realtime_offset;
+    dump_record(buf + sizeof(frame), iface, type, ts, ptr, len);
+    dump_frame_put(&frame, buf, len);
+}
+
+
+/**
+ * Binary capture record handler.
+ *
+ * @param rec   Record header, UHD_CAPTURE_RECORD_LEN bytes.
+ * @param ts    Record timestamp, translated to CLOCK_REALTIME ns.
+ * @param data  Record data.
+ * @param len   Record data length.
+ * @param user  Handler data.
+ *
+ * @return True if handled successfully, false to stop reading.
+ */
+typedef bool (*capture_record_fn)(const uint8_t    *rec,
+                                  uint64_t          ts,
+                                  const uint8_t    *data,
+                                  uint32_t          len,
+                                  void             *user);
+
+/**
+ * Read a binary capture, passing every record to a handler.
+ *
+ * @param stream    The stream to read the binary capture from.
+ * @param fn        The record handler.
+ * @param user      The record handler data.
+ *
+ * @return True if read and handled successfully, false otherwise.
+ */
+static bool
+read_capture(FILE *stream, capture_record_fn fn, void *user)
+{
+    uint8_t     hdr[UHD_CAPTURE_HEADER_LEN];
+    uint8_t     rec[UHD_CAPTURE_RECORD_LEN];
+    uint8_t    *data    = NULL;
+    size_t      size    = 0;
+    uint8_t    *p;
+    uint32_t    hdr_len;
+    uint64_t    realtime;
+    uint64_t    monotonic;
+    uint32_t    len;
+    size_t      n;
+    bool        result  = false;
+
+    if (fread(hdr, sizeof(hdr), 1, stream) != 1 ||
+        memcmp(hdr, UHD_CAPTURE_MAGIC, 8) != 0)
+        ERROR_CLEANUP("Not a usbhid-dump binary capture");
+    if (uhd_capture_get_le(hdr + 8, 4) != UHD_CAPTURE_VERSION)
+        ERROR_CLEANUP("Unsupported binary capture version %u",
+                      (unsigned int)uhd_capture_get_le(hdr + 8, 4));
+    hdr_len = uhd_capture_get_le(hdr + 12, 4);
+    if (hdr_len < UHD_CAPTURE_HEADER_LEN)
+        ERROR_CLEANUP("Invalid binary capture header length %u", hdr_len);
+    realtime = uhd_capture_get_le(hdr + 16, 8);
+    monotonic = uhd_capture_get_le(hdr + 24, 8);
+
+    /* Skip header fields added by later versions */
+    for (; hdr_len > UHD_CAPTURE_HEADER_LEN; hdr_len--)
+        if (getc(stream) == EOF)
+            ERROR_CLEANUP("Truncated binary capture header");
+
+    while ((n = fread(rec, 1, sizeof(rec), stream)) == sizeof(rec))
     {
-        if (iface->rd_len > sizeof(buf))
+        len = uhd_capture_get_le(rec + 8, 4);
+        if (len > size)
         {
-            err = LIBUSB_ERROR_NO_MEM;
-            LIBUSB_IFACE_FAILURE(iface, "report descriptor too long: %hu",
-                                 iface->rd_len);
-            return false;
+            p = realloc(data, len);
+            if (p == NULL)
+                FAILURE_CLEANUP("allocate %u bytes for a record", len);
+            data = p;
+            size = len;
         }
+        if (len > 0 && fread(data, len, 1, stream) != 1)
+            ERROR_CLEANUP("Truncated binary capture record");
+
+        /* Translate the monotonic timestamp to wall-clock time */
+        if (!fn(rec, realtime + (uhd_capture_get_le(rec, 8) - monotonic),
+                data, len, user))
+            goto cleanup;
+    }
+
+    if (ferror(stream))
+        ERROR_CLEANUP("Failed to read binary capture: %s", strerror(errno));
+    if (n != 0)
+        ERROR_CLEANUP("Truncated binary capture record");
+
+    result = true;
+
+cleanup:
+    free(data);
+    return result;
+}
+
+
+static bool
+convert_record(const uint8_t   *rec,
+               uint64_t         ts,
+               const uint8_t   *data,
+               uint32_t         len,
+               void            *user)
+{
+    dump_frame  frame;
+    uint8_t    *buf;
+
+    (void)user;
+
+    /* Skip record types we don't know about */
+    if (rec[12] != UHD_CAPTURE_TYPE_DESCRIPTOR &&
+        rec[12] != UHD_CAPTURE_TYPE_STREAM &&
+        rec[12] != UHD_CAPTURE_TYPE_OUTPUT)
+        return true;
+
+    buf = dump_buf(&dump_chunk_buf,
+                   sizeof(frame) + UHD_CAPTURE_RECORD_LEN + len);
+    if (buf == NULL)
+        return false;
+    frame.plan = NULL;
+    frame.offset = ts - uhd_capture_get_le(rec, 8);
+    memcpy(buf + sizeof(frame), rec, UHD_CAPTURE_RECORD_LEN);
+    if (len > 0)
+        memcpy(buf + sizeof(frame) + UHD_CAPTURE_RECORD_LEN, data, len);
+    dump_frame_put(&frame, buf, len);
+
+    return true;
+}
+
+
+/**
+ * Convert a binary capture to the text format.
+ *
+ * @param stream    The stream to read the binary capture from.
+ *
+ * @return True if converted successfully, false otherwise.
+ */
+static bool
+convert(FILE *stream)
+{
+    return read_capture(stream, convert_record, NULL);
+}
 
-        rc = libusb_control_transfer(iface->dev->handle,
-                                     /* See HID spec, 7.1.1 */
-                                     0x81,
-                                     LIBUSB_REQUEST_GET_DESCRIPTOR,
-                                     (LIBUSB_DT_REPORT << 8), iface->number,
-                                     buf, iface->rd_len, UHD_IO_TIMEOUT);
-        if (rc < 0)
+
+/** Round-trip latency measured from a replayed capture, a list member */
+typedef struct replay_iface replay_iface;
+
+struct replay_iface {
+    replay_iface   *next;
+    char            addr_str[12];   /**< Interface address string */
+    uhd_latency    *latency;        /**< Latency measurement state */
+};
+
+
+static bool
+replay_record(const uint8_t    *rec,
+              uint64_t          ts,
+              const uint8_t    *data,
+              uint32_t          len,
+              void             *user)
+{
+    replay_iface  **plist   = (replay_iface **)user;
+    replay_iface   *ri;
+    char            addr_str[12];
+
+    /* Only the probes sent and the reports received matter */
+    if (rec[12] != UHD_CAPTURE_TYPE_OUTPUT &&
+        rec[12] != UHD_CAPTURE_TYPE_STREAM)
+        return true;
+
+    snprintf(addr_str, sizeof(addr_str), "%.3hhu:%.3hhu:%.3hhu",
+             rec[13], rec[14], rec[15]);
+
+    /* Find the interface, adding it in order of appearance, if new */
+    for (; (ri = *plist) != NULL; plist = &ri->next)
+        if (strcmp(ri->addr_str, addr_str) == 0)
+            break;
+    if (ri == NULL)
+    {
+        ri = calloc(1, sizeof(*ri));
+        if (ri == NULL || (ri->latency = uhd_latency_new(NULL, 0, -1)) == NULL)
         {
-            err = rc;
-            LIBUSB_IFACE_FAILURE(iface, "retrieve report descriptor");
+            free(ri);
+            GENERIC_FAILURE("allocate latency measurement state");
             return false;
         }
-        dump(iface, "DESCRIPTOR", buf, rc);
+        memcpy(ri->addr_str, addr_str, sizeof(addr_str));
+        *plist = ri;
     }
 
+    if (rec[12] == UHD_CAPTURE_TYPE_OUTPUT)
+        uhd_latency_sent(ri->latency, ts, data, len);
+    else
+        uhd_latency_received(ri->latency, ts, data, len);
+
     return true;
 }
 
 
-static void LIBUSB_CALL
-dump_iface_list_stream_cb(struct libusb_transfer *transfer)
+/**
+ * Measure round-trip latency of the probes in a binary capture and
+ * print the results.
+ *
+ * @param stream    The stream to read the binary capture from.
+ *
+ * @return True if measured successfully, false otherwise.
+ */
+static bool
+replay_latency(FILE *stream)
 {
-    enum libusb_error   err;
-    uhd_iface          *iface;
+    replay_iface   *list    = NULL;
+    replay_iface   *ri;
+    bool            result;
 
-    assert(transfer != NULL);
+    result = read_capture(stream, replay_record, &list);
 
-    iface = (uhd_iface *)transfer->user_data;
-    assert(uhd_iface_valid(iface));
+    for (; list != NULL; list = ri)
+    {
+        ri = list->next;
+        if (result)
+            uhd_latency_print(stdout, list->addr_str, list->latency);
+        uhd_latency_free(list->latency);
+        free(list);
+    }
 
-    /* Clear interface "has transfer submitted" flag */
-    iface->submitted = false;
+    return result;
+}
 
-    switch (transfer->status)
-    {
-        case LIBUSB_TRANSFER_COMPLETED:
-            /* Dump the result */
-            if (!stream_paused)
-            {
-                dump(iface, "STREAM",
-                     transfer->buffer, transfer->actual_length);
-                if (stream_feedback)
-                    fputc('.', stderr);
-            }
-            /* Resubmit the transfer */
-            err = libusb_submit_transfer(transfer);
-            if (err != LIBUSB_SUCCESS)
-                LIBUSB_IFACE_FAILURE(iface, "resubmit a transfer");
-            else
-            {
-                /* Set interface "has transfer submitted" flag */
-                iface->submitted = true;
-            }
-            break;
 
-#define MAP(_name, _desc) \
-    case LIBUSB_TRANSFER_##_name: \
-        IFACE_ERROR(iface, _desc);  \
-        break
+/**
+ * Retrieve the report descriptor of an interface, reporting failures.
+ *
+ * @param iface The interface to retrieve the report descriptor of.
+ * @param buf   Output buffer, UHD_MAX_DESCRIPTOR_SIZE bytes.
+ *
+ * @return Report descriptor length, or a negative libusb error code.
+ */
+static int
+get_iface_descriptor(const uhd_iface *iface, uint8_t *buf)
+{
+    int                 rc;
+    enum libusb_error   err;
 
-        MAP(ERROR,      "Interrupt transfer failed");
-        MAP(TIMED_OUT,  "Interrupt transfer timed out");
-        MAP(STALL,      "Interrupt transfer halted (endpoint stalled)");
-        MAP(NO_DEVICE,  "Device was disconnected");
-        MAP(OVERFLOW,   "Interrupt transfer overflowed "
-                        "(device sent more data than requested)");
-#undef MAP
+    if (iface->rd_len > UHD_MAX_DESCRIPTOR_SIZE)
+    {
+        err = LIBUSB_ERROR_NO_MEM;
+        LIBUSB_IFACE_FAILURE(iface, "report descriptor too long: %hu",
+                             iface->rd_len);
+        return err;
+    }
 
-        case LIBUSB_TRANSFER_CANCELLED:
-            break;
+    rc = libusb_control_transfer(iface->dev->handle,
+                                 /* See HID spec, 7.1.1 */
+                                 0x81,
+                                 LIBUSB_REQUEST_GET_DESCRIPTOR,
+                                 (LIBUSB_DT_REPORT << 8), iface->number,
+                                 buf, iface->rd_len, UHD_IO_TIMEOUT);
+    if (rc < 0)
+    {
+        err = rc;
+        LIBUSB_IFACE_FAILURE(iface, "retrieve report descriptor");
     }
+
+    return rc;
 }
 
 
-static const char *
-format_time_interval(unsigned int i)
+/**
+ * Compile the report decoding plan of an interface, reporting failures.
+ * The stream is dumped undecoded, if failed.
+ *
+ * @param iface The interface to compile the plan for.
+ * @param rd    Report descriptor of the interface.
+ * @param len   Report descriptor length.
+ */
+static void
+compile_iface_plan(uhd_iface *iface, const uint8_t *rd, size_t len)
 {
-    static char     buf[128];
-    char           *p           = buf;
-    unsigned int    h           = i / (60 * 60 * 1000);
-    unsigned int    m           = (i % (60 * 60 * 1000)) / (60 * 1000);
-    unsigned int    s           = (i % (60 * 1000)) / 1000;
-    unsigned int    ms          = i % 1000;
+    assert(iface->plan == NULL);
 
-#define FRACTION(_prev_sum, _name, _val) \
-    do {                                                \
-        if ((_val) > 0)                                 \
-            p += snprintf(p, sizeof(buf) - (p - buf),   \
-                          "%s%u " _name "%s",           \
-                          ((_prev_sum) > 0 ? " " : ""), \
-                          _val,                         \
-                          (((_val) == 1) ? "" : "s"));  \
-        if (p >= (buf + sizeof(buf)))                   \
-            return buf;                                 \
-    } while (0)
+    iface->plan = uhd_plan_new(rd, len);
+    if (iface->plan == NULL)
+        IFACE_ERROR(iface, "Failed to compile report descriptor, "
+                           "ignoring");
+}
+
+
+static bool
+dump_iface_descriptor(uhd_iface *iface)
+{
+    uint8_t             buf[UHD_MAX_DESCRIPTOR_SIZE] = {0};
+    int                 rc;
+
+    rc = get_iface_descriptor(iface, buf);
+    if (rc < 0)
+        return false;
+
+    dump(iface, UHD_CAPTURE_TYPE_DESCRIPTOR,
+         clock_ns(CLOCK_MONOTONIC), buf, rc);
+
+    /* Compile the plan while the descriptor is at hand */
+    if ((decode || changes_only) && iface->plan == NULL)
+        compile_iface_plan(iface, buf, rc);
+
+    return true;
+}
+
+
+/** Asynchronous report descriptor request */
+typedef struct descriptor_request {
+    uhd_iface                  *iface;      /**< Interface to retrieve the
+                                                 descriptor of */
+    struct libusb_transfer     *transfer;   /**< Control transfer */
+    bool                        submitted;  /**< True if the transfer was
+                                                 submitted */
+    bool                        done;       /**< True if the transfer is
+                                                 no longer in flight */
+    uint64_t                    ts;         /**< Completion timestamp,
+                                                 monotonic ns */
+    size_t                     *pending;    /**< Number of requests in
+                                                 flight */
+} descriptor_request;
+
+
+static void LIBUSB_CALL
+descriptor_request_cb(struct libusb_transfer *transfer)
+{
+    descriptor_request *req;
+
+    assert(transfer != NULL);
+
+    req = (descriptor_request *)transfer->user_data;
+    req->ts = clock_ns(CLOCK_MONOTONIC);
+    req->done = true;
+    (*req->pending)--;
+}
+
+
+/**
+ * Submit a report descriptor request, reporting failures.
+ *
+ * @param req   The request to submit, with the interface and pending
+ *              counter set.
+ *
+ * @return True if submitted, false otherwise.
+ */
+static bool
+descriptor_request_submit(descriptor_request *req)
+{
+    uhd_iface          *iface   = req->iface;
+    enum libusb_error   err;
+    uint8_t            *buf;
+
+    if (iface->rd_len > UHD_MAX_DESCRIPTOR_SIZE)
+    {
+        err = LIBUSB_ERROR_NO_MEM;
+        LIBUSB_IFACE_FAILURE(iface, "report descriptor too long: %hu",
+                             iface->rd_len);
+        return false;
+    }
+
+    req->transfer = libusb_alloc_transfer(0);
+    if (req->transfer == NULL)
+    {
+        IFACE_ERROR(iface, "Failed to allocate a transfer");
+        return false;
+    }
+
+    buf = malloc(LIBUSB_CONTROL_SETUP_SIZE + iface->rd_len);
+    if (buf == NULL)
+    {
+        IFACE_ERROR(iface, "Failed to allocate a transfer buffer");
+        return false;
+    }
+
+    /* See HID spec, 7.1.1 */
+    libusb_fill_control_setup(buf, 0x81, LIBUSB_REQUEST_GET_DESCRIPTOR,
+                              (LIBUSB_DT_REPORT << 8), iface->number,
+                              iface->rd_len);
+    libusb_fill_control_transfer(req->transfer, iface->dev->handle, buf,
+                                 descriptor_request_cb, req,
+                                 UHD_IO_TIMEOUT);
+    req->transfer->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
+
+    err = libusb_submit_transfer(req->transfer);
+    if (err != LIBUSB_SUCCESS)
+    {
+        LIBUSB_IFACE_FAILURE(iface, "retrieve report descriptor");
+        return false;
+    }
+
+    req->submitted = true;
+    (*req->pending)++;
+    return true;
+}
+
+
+/**
+ * Dump the report descriptor retrieved by a finished request, reporting
+ * failures.
+ *
+ * @param req   The request to dump the result of.
+ *
+ * @return True if dumped, false if the request failed.
+ */
+static bool
+descriptor_request_dump(const descriptor_request *req)
+{
+    uhd_iface                  *iface       = req->iface;
+    struct libusb_transfer     *transfer    = req->transfer;
+    enum libusb_error           err;
+    const uint8_t              *rd;
+
+    assert(req->done);
+
+    /* Submission failures are reported already */
+    if (!req->submitted)
+        return false;
+
+    /* Map the status the way synchronous transfers do */
+    switch (transfer->status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED:
+            err = LIBUSB_SUCCESS;
+            break;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            err = LIBUSB_ERROR_TIMEOUT;
+            break;
+        case LIBUSB_TRANSFER_STALL:
+            err = LIBUSB_ERROR_PIPE;
+            break;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            err = LIBUSB_ERROR_NO_DEVICE;
+            break;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            err = LIBUSB_ERROR_OVERFLOW;
+            break;
+        default:
+            err = LIBUSB_ERROR_IO;
+            break;
+    }
+    if (err != LIBUSB_SUCCESS)
+    {
+        LIBUSB_IFACE_FAILURE(iface, "retrieve report descriptor");
+        return false;
+    }
+
+    rd = libusb_control_transfer_get_data(transfer);
+    dump(iface, UHD_CAPTURE_TYPE_DESCRIPTOR,
+         req->ts, rd, transfer->actual_length);
+
+    /* Compile the plan while the descriptor is at hand */
+    if ((decode || changes_only) && iface->plan == NULL)
+        compile_iface_plan(iface, rd, transfer->actual_length);
+
+    return true;
+}
+
+
+/**
+ * Dump the report descriptors of every interface in a list. The
+ * descriptors are requested from all the interfaces at once, so a slow
+ * device doesn't hold up the others, but are dumped in list order, each
+ * as soon as it and the ones before it have arrived. Stops dumping at
+ * the first failure, as if retrieved one by one.
+ *
+ * @param list  The interface list to dump the descriptors of.
+ *
+ * @return True if all descriptors were dumped, false otherwise.
+ */
+static bool
+dump_iface_list_descriptor(uhd_iface *list)
+{
+    bool                    result      = false;
+    enum libusb_error       err;
+    uhd_iface              *iface;
+    descriptor_request     *req_list    = NULL;
+    descriptor_request     *req;
+    descriptor_request     *next;
+    size_t                  req_num     = 0;
+    size_t                  pending     = 0;
+
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+        req_num++;
+
+    req_list = calloc(req_num, sizeof(*req_list));
+    if (req_list == NULL)
+        FAILURE_CLEANUP("allocate report descriptor requests");
+
+    /* Submit all the requests, stopping at the first failure */
+    req = req_list;
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+    {
+        req->iface = iface;
+        req->pending = &pending;
+        if (!descriptor_request_submit(req))
+        {
+            req->done = true;
+            req_num = req - req_list + 1;
+            break;
+        }
+        req++;
+    }
+
+    /* Dump the descriptors in list order, as they arrive */
+    result = true;
+    next = req_list;
+    while (true)
+    {
+        for (; result && next < req_list + req_num && next->done; next++)
+            if (!descriptor_request_dump(next))
+            {
+                result = false;
+                /* Don't wait for the descriptors we won't dump */
+                for (req = next + 1; req < req_list + req_num; req++)
+                    if (!req->done)
+                        libusb_cancel_transfer(req->transfer);
+            }
+
+        if (pending == 0)
+            break;
+
+        err = uhd_loop_run_once(loop);
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
+        {
+            LIBUSB_FAILURE("handle report descriptor request events, "
+                           "abandoning the requests");
+            result = false;
+            /* Neither the transfers in flight nor their requests can go */
+            req_list = NULL;
+            goto cleanup;
+        }
+    }
+
+    for (req = req_list; req < req_list + req_num; req++)
+        if (req->transfer != NULL)
+            libusb_free_transfer(req->transfer);
+
+cleanup:
+    free(req_list);
+    return result;
+}
+
+
+/**
+ * Request the pre-trigger histories dumped, unless already requested.
+ *
+ * @param iface The interface which triggered the dump.
+ * @param ts    Trigger timestamp, CLOCK_MONOTONIC ns.
+ * @param desc  Trigger description.
+ */
+static void
+trigger_iface_history(const uhd_iface *iface, uint64_t ts, const char *desc)
+{
+    if (trigger_requested)
+        return;
+
+    fprintf(stderr, "%s:Triggered by %s\n", iface->addr_str, desc);
+    trigger_ts = ts;
+    trigger_requested = 1;
+}
+
+
+/**
+ * Mark an interface's device disconnected, reporting it the first time.
+ *
+ * @param iface The interface to mark.
+ */
+static void
+mark_iface_disconnected(uhd_iface *iface)
+{
+    if (!iface->disconnected)
+    {
+        IFACE_ERROR(iface, "Device was disconnected");
+        iface->disconnected = true;
+        retire_pending = true;
+        /* Dump what led up to it, before the history is freed */
+        if (iface->history != NULL)
+            trigger_iface_history(iface, clock_ns(CLOCK_MONOTONIC),
+                                  "disconnection");
+    }
+}
+
+
+/**
+ * Account a stream transfer submitted for an interface.
+ *
+ * @param iface The interface the transfer was submitted for.
+ */
+static void
+iface_submitted_inc(uhd_iface *iface)
+{
+    iface->submitted++;
+    __atomic_add_fetch(&inflight, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Account a stream transfer of an interface no longer in flight.
+ *
+ * @param iface The interface the transfer was submitted for.
+ */
+static void
+iface_submitted_dec(uhd_iface *iface)
+{
+    assert(iface->submitted > 0);
+    iface->submitted--;
+    __atomic_sub_fetch(&inflight, 1, __ATOMIC_RELAXED);
+    /* Let the interface be retired, if it's not streaming anymore */
+    if (iface->submitted == 0)
+        retire_pending = true;
+}
+
+
+/**
+ * Put a stream report into the pre-trigger history of an interface, and
+ * request the history dumped if the report matches a trigger.
+ *
+ * @param iface The interface the report came from.
+ * @param ts    Report timestamp, CLOCK_MONOTONIC ns.
+ * @param gap   Time since the previous report, ns, zero if none.
+ * @param data  Report data.
+ * @param len   Report length.
+ */
+static void
+iface_history_put(uhd_iface        *iface,
+                  uint64_t          ts,
+                  uint64_t          gap,
+                  const uint8_t    *data,
+                  size_t            len)
+{
+    const uhd_trigger  *trigger;
+
+    uhd_history_put(iface->history, ts, data, len);
+
+    trigger = uhd_trigger_list_match(trigger_list, data, len, gap);
+    if (trigger != NULL)
+        trigger_iface_history(iface, ts, trigger->desc);
+}
+
+
+/**
+ * Dump the pre-trigger histories of every interface in a list, merged
+ * in timestamp order, starting the pre-trigger period before the trigger,
+ * and empty them.
+ *
+ * @param list  The interface list to dump the histories of.
+ */
+static void
+dump_iface_list_history(uhd_iface *list)
+{
+    uhd_iface          *iface;
+    uhd_iface          *oldest;
+    uint64_t            oldest_ts   = 0;
+    uint64_t            since;
+    uint64_t            ts;
+    const uint8_t      *data;
+    size_t              len;
+
+    /* Triggered with a signal, if not known */
+    if (trigger_ts == 0)
+        trigger_ts = clock_ns(CLOCK_MONOTONIC);
+    since = trigger_ts > pretrigger ? trigger_ts - pretrigger : 0;
+    trigger_ts = 0;
+
+    while (true)
+    {
+        oldest = NULL;
+        UHD_IFACE_LIST_FOR_EACH(iface, list)
+            if (iface->history != NULL &&
+                uhd_history_oldest(iface->history, &ts, &data, &len) &&
+                (oldest == NULL || ts < oldest_ts))
+            {
+                oldest = iface;
+                oldest_ts = ts;
+            }
+        if (oldest == NULL)
+            break;
+
+        uhd_history_oldest(oldest->history, &ts, &data, &len);
+        if (ts >= since)
+            dump(oldest, UHD_CAPTURE_TYPE_STREAM, ts, data, len);
+        uhd_history_pop(oldest->history);
+    }
+}
+
+
+static void LIBUSB_CALL
+dump_iface_list_stream_cb(struct libusb_transfer *transfer)
+{
+    enum libusb_error   err;
+    uhd_iface          *iface;
+    /* Take the timestamp as close to the completion as possible */
+    uint64_t            ts      = clock_ns(CLOCK_MONOTONIC);
+    uint64_t            gap;
+
+    assert(transfer != NULL);
+
+    iface = (uhd_iface *)transfer->user_data;
+    assert(uhd_iface_valid(iface));
+
+    switch (transfer->status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED:
+            /* Account the report */
+            if (iface->stats != NULL)
+                uhd_stats_add(iface->stats, ts);
+            gap = iface->last_ts != 0 ? ts - iface->last_ts : 0;
+            iface->last_ts = ts;
+            iface->restart_num = 0;
+            /* Check if it answers a latency probe */
+            if (iface->latency != NULL)
+                uhd_latency_received(iface->latency, ts, transfer->buffer,
+                                     transfer->actual_length);
+            /* Dump the result, unless paused or a duplicate */
+            if (!stream_paused &&
+                (iface->delta == NULL ||
+                 uhd_delta_changed(iface->delta,
+                                   iface->plan != NULL &&
+                                   iface->plan->numbered &&
+                                   transfer->actual_length > 0
+                                        ? transfer->buffer[0] : 0,
+                                   transfer->buffer,
+                                   transfer->actual_length)))
+            {
+                if (iface->history != NULL)
+                    iface_history_put(iface, ts, gap, transfer->buffer,
+                                      transfer->actual_length);
+                else
+                    dump(iface, UHD_CAPTURE_TYPE_STREAM, ts,
+                         transfer->buffer, transfer->actual_length);
+                if (stream_feedback)
+                    fputc('.', stderr);
+            }
+            /* Resubmit the transfer, keeping it in flight */
+            err = libusb_submit_transfer(transfer);
+            if (err == LIBUSB_SUCCESS)
+                return;
+            LIBUSB_IFACE_FAILURE(iface, "resubmit a transfer");
+            break;
+
+#define MAP(_name, _desc) \
+    case LIBUSB_TRANSFER_##_name: \
+        IFACE_ERROR(iface, _desc);  \
+        break
+
+        MAP(ERROR,      "Interrupt transfer failed");
+        MAP(STALL,      "Interrupt transfer halted (endpoint stalled)");
+        MAP(OVERFLOW,   "Interrupt transfer overflowed "
+                        "(device sent more data than requested)");
+#undef MAP
+
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            /* Just keep waiting, if streaming until interrupted */
+            if (stream_restart)
+            {
+                err = libusb_submit_transfer(transfer);
+                if (err == LIBUSB_SUCCESS)
+                    return;
+                LIBUSB_IFACE_FAILURE(iface, "resubmit a transfer");
+                break;
+            }
+            IFACE_ERROR(iface, "Interrupt transfer timed out");
+            break;
+
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            mark_iface_disconnected(iface);
+            break;
+
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+    }
+
+    /* The transfer is no longer in flight */
+    iface_submitted_dec(iface);
+}
+
+
+static void LIBUSB_CALL
+iface_latency_cb(struct libusb_transfer *transfer)
+{
+    uhd_iface          *iface;
+
+    assert(transfer != NULL);
+
+    iface = (uhd_iface *)transfer->user_data;
+    assert(uhd_iface_valid(iface));
+
+    iface->latency_busy = false;
+
+    switch (transfer->status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED:
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            mark_iface_disconnected(iface);
+            uhd_latency_abort(iface->latency);
+            break;
+
+        default:
+            IFACE_ERROR(iface, "Latency probe transfer failed");
+            uhd_latency_abort(iface->latency);
+            break;
+    }
+
+    /* The transfer is no longer in flight */
+    iface_submitted_dec(iface);
+}
+
+
+/**
+ * Send the next latency probe of an interface.
+ *
+ * @param iface The interface to send the probe to.
+ * @param now   Current time, CLOCK_MONOTONIC ns.
+ */
+static void
+iface_latency_send(uhd_iface *iface, uint64_t now)
+{
+    enum libusb_error       err;
+    struct libusb_transfer *transfer;
+    uint8_t                *data;
+    uint64_t                ts;
+
+    /* The probe transfer goes after the stream ones */
+    transfer = iface->transfer_list[iface->transfer_num - 1];
+    data = transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL
+                ? libusb_control_transfer_get_data(transfer)
+                : transfer->buffer;
+    memcpy(data, uhd_latency_next(iface->latency), iface->latency->len);
+
+    /* Keep the rate steady, unless fallen behind */
+    iface->latency_next += latency_period;
+    if (iface->latency_next <= now)
+        iface->latency_next = now + latency_period;
+
+    /* Take the timestamp as close to the submission as possible */
+    ts = clock_ns(CLOCK_MONOTONIC);
+    err = libusb_submit_transfer(transfer);
+    if (err != LIBUSB_SUCCESS)
+    {
+        LIBUSB_IFACE_FAILURE(iface, "submit a latency probe");
+        return;
+    }
+    iface_submitted_inc(iface);
+    iface->latency_busy = true;
+
+    uhd_latency_sent(iface->latency, ts, data, iface->latency->len);
+    if (!stream_paused && iface->history == NULL)
+        dump(iface, UHD_CAPTURE_TYPE_OUTPUT, ts, data, iface->latency->len);
+}
+
+
+/**
+ * Send the latency probes due for every streaming interface in a list,
+ * and set the event loop deadline to the time the next one is due.
+ *
+ * @param list  The interface list to send the probes to.
+ */
+static void
+schedule_iface_list_latency(uhd_iface *list)
+{
+    uhd_iface  *iface;
+    uint64_t    now;
+    uint64_t    deadline    = 0;
+
+    if (latency == NULL)
+        return;
+
+    now = clock_ns(CLOCK_MONOTONIC);
+
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+    {
+        /* Skip interfaces not streaming, or waiting for a probe to go */
+        if (iface->latency == NULL || iface->disconnected ||
+            iface->latency_busy || iface->submitted == 0)
+            continue;
+
+        if (now >= iface->latency_next)
+            iface_latency_send(iface, now);
+
+        if (!iface->latency_busy &&
+            (deadline == 0 || iface->latency_next < deadline))
+            deadline = iface->latency_next;
+    }
+
+    uhd_loop_set_deadline(loop, deadline);
+}
+
+
+static const char *
+format_time_interval(unsigned int i)
+{
+    static char     buf[128];
+    char           *p           = buf;
+    unsigned int    h           = i / (60 * 60 * 1000);
+    unsigned int    m           = (i % (60 * 60 * 1000)) / (60 * 1000);
+    unsigned int    s           = (i % (60 * 1000)) / 1000;
+    unsigned int    ms          = i % 1000;
+
+#define FRACTION(_prev_sum, _name, _val) \
+    do {                                                \
+        if ((_val) > 0)                                 \
+            p += snprintf(p, sizeof(buf) - (p - buf),   \
+                          "%s%u " _name "%s",           \
+                          ((_prev_sum) > 0 ? " " : ""), \
+                          _val,                         \
+                          (((_val) == 1) ? "" : "s"));  \
+        if (p >= (buf + sizeof(buf)))                   \
+            return buf;                                 \
+    } while (0)
+
+    FRACTION(0, "hour", h);
+    FRACTION(h, "minute", m);
+    FRACTION(h + m, "second", s);
+    FRACTION(h + m + s, "millisecond", ms);
+
+#undef FRACTION
+
+    return buf;
+}
+
+
+static const char *
+format_timeout(unsigned int i)
+{
+    return (i == 0) ? "infinite" : format_time_interval(i);
+}
+
+
+/**
+ * Print stream statistics and round-trip latency of an interface, if
+ * collected.
+ *
+ * @param iface The interface to print statistics for.
+ */
+static void
+print_iface_stats(const uhd_iface *iface)
+{
+    if (iface->stats != NULL)
+        uhd_stats_print(stderr, iface->addr_str, iface->stats);
+    if (iface->latency != NULL)
+        uhd_latency_print(stderr, iface->addr_str, iface->latency);
+}
+
+
+/**
+ * Print stream statistics and round-trip latency of every interface in a
+ * list which has them.
+ *
+ * @param list  The interface list to print statistics for.
+ */
+static void
+print_iface_list_stats(const uhd_iface *list)
+{
+    const uhd_iface    *iface;
+
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+        print_iface_stats(iface);
+}
+
+
+/**
+ * Print the number of duplicate reports suppressed for an interface.
+ *
+ * @param iface The interface to print the number for.
+ * @param total True to print the total number, false to print the number
+ *              since the last summary, if any.
+ */
+static void
+print_iface_changes(uhd_iface *iface, bool total)
+{
+    if (iface->delta == NULL)
+        return;
+
+    if (total)
+        fprintf(stderr, "%s: %llu duplicate reports suppressed in total\n",
+                iface->addr_str,
+                (unsigned long long int)iface->delta->total);
+    else if (iface->delta->suppressed > 0)
+        fprintf(stderr, "%s: %llu duplicate reports suppressed\n",
+                iface->addr_str,
+                (unsigned long long int)iface->delta->suppressed);
+
+    iface->delta->suppressed = 0;
+}
+
+
+/**
+ * Print the numbers of duplicate reports suppressed since the last
+ * summary for an interface list, if the summary period has passed.
+ *
+ * @param list  The interface list to print the numbers for.
+ */
+static void
+summarize_iface_list_changes(uhd_iface *list)
+{
+    static uint64_t     next    = 0;
+    uint64_t            now;
+    uhd_iface          *iface;
+
+    if (changes_period == 0)
+        return;
+
+    now = clock_ns(CLOCK_MONOTONIC);
+    if (now < next)
+        return;
+
+    /* Don't summarize right at the start */
+    if (next != 0)
+        UHD_IFACE_LIST_FOR_EACH(iface, list)
+            print_iface_changes(iface, false);
+
+    next = now + (uint64_t)changes_period * 1000000000;
+}
+
+
+/**
+ * Check if any stream transfers are in flight, without looking through
+ * the interfaces.
+ *
+ * @return True if there are submitted transfers, false otherwise.
+ */
+static bool
+any_submitted(void)
+{
+    return __atomic_load_n(&inflight, __ATOMIC_RELAXED) > 0;
+}
+
+
+/**
+ * Start streaming an interface: switch it to the report protocol, set
+ * infinite idle duration and submit its interrupt transfers. Prepare the
+ * latency probe transfer, if measuring round-trip latency.
+ *
+ * @param iface         The interface to start streaming.
+ * @param timeout       Interrupt transfer timeout, ms.
+ * @param queue_depth   Number of transfers to keep submitted.
+ * @param stats         True if stream statistics should be collected.
+ *
+ * @return True if started successfully, false otherwise. Some transfers
+ *         could be left submitted even if failed.
+ */
+static bool
+iface_stream_start(uhd_iface       *iface,
+                   unsigned int     timeout,
+                   unsigned int     queue_depth,
+                   bool             stats)
+{
+    bool                        result  = false;
+    enum libusb_error           err;
+    struct libusb_transfer    **ptransfer;
+    struct libusb_transfer     *transfer;
+    void                       *buf;
+    bool                        dev_mem;
+    const size_t                len     = iface->int_in_ep_maxp;
+    uint8_t                     rd[UHD_MAX_DESCRIPTOR_SIZE];
+    int                         rc;
+    uint8_t                     id;
+    uint64_t                    slot_num;
+    uint64_t                    slot_max;
+    uint64_t                    held;
+
+    assert(uhd_iface_valid(iface));
+    assert(iface->transfer_list == NULL);
+    assert(queue_depth > 0);
+
+    /* Set report protocol */
+    LIBUSB_IFACE_GUARD(uhd_iface_set_protocol(iface, true, UHD_IO_TIMEOUT),
+                       iface, "set report protocol");
+    /* Set infinite idle duration */
+    LIBUSB_IFACE_GUARD(uhd_iface_set_idle(iface, 0, UHD_IO_TIMEOUT),
+                       iface, "set infinite idle duration");
+    /* Allocate statistics, if requested */
+    if (stats && iface->stats == NULL)
+    {
+        iface->stats = uhd_stats_new();
+        if (iface->stats == NULL)
+            FAILURE_CLEANUP("allocate stream statistics");
+    }
+    /*
+     * Compile the plan, if not done yet, to decode reports, or to tell
+     * their IDs when suppressing duplicates, or sending latency probes
+     */
+    if ((decode || changes_only || latency != NULL) && iface->plan == NULL)
+    {
+        rc = get_iface_descriptor(iface, rd);
+        if (rc >= 0)
+            compile_iface_plan(iface, rd, rc);
+    }
+    /*
+     * Allocate the pre-trigger history, if requested, with a slot for
+     * every service interval of the pre-trigger period, within budget
+     */
+    if (pretrigger != 0 && iface->history == NULL)
+    {
+        slot_num = pretrigger /
+                   ((uint64_t)iface->int_in_ep_interval * 1000) + 1;
+        slot_max = UHD_HISTORY_SIZE_MAX / uhd_history_slot_size(len);
+        if (slot_num > slot_max)
+        {
+            slot_num = slot_max;
+            held = slot_num * iface->int_in_ep_interval / 1000;
+            IFACE_ERROR(iface, "Pre-trigger history can only hold "
+                               "%llu.%.3u s of reports at the full rate",
+                        (unsigned long long)(held / 1000),
+                        (unsigned int)(held % 1000));
+        }
+        iface->history = uhd_history_new(slot_num, len);
+        if (iface->history == NULL)
+            FAILURE_CLEANUP("allocate pre-trigger history");
+    }
+    /* Allocate duplicate suppression state, if requested */
+    if (changes_only && iface->delta == NULL)
+    {
+        iface->delta = uhd_delta_new();
+        if (iface->delta == NULL)
+            FAILURE_CLEANUP("allocate duplicate report suppression state");
+    }
+    /* Allocate latency measurement state, if requested */
+    if (latency != NULL && iface->latency == NULL)
+    {
+        iface->latency = uhd_latency_new(latency->report, latency->len,
+                                         latency->seq_offset);
+        if (iface->latency == NULL)
+            FAILURE_CLEANUP("allocate latency measurement state");
+    }
+
+    /* Allocate zeroed transfer list, with room for the probe transfer */
+    iface->transfer_num = queue_depth + (iface->latency != NULL ? 1 : 0);
+    iface->transfer_list = calloc(iface->transfer_num,
+                                  sizeof(*iface->transfer_list));
+    if (iface->transfer_list == NULL)
+    {
+        iface->transfer_num = 0;
+        FAILURE_CLEANUP("allocate transfer list");
+    }
+
+    /* Allocate the transfers and initialize them as interrupt transfers */
+    for (ptransfer = iface->transfer_list;
+         ptransfer < iface->transfer_list + queue_depth;
+         ptransfer++)
+    {
+        *ptransfer = libusb_alloc_transfer(0);
+        if (*ptransfer == NULL)
+            FAILURE_CLEANUP("allocate a transfer");
+
+        /*
+         * Allocate the transfer buffer in memory shared with the kernel,
+         * if supported, so completed transfers aren't copied
+         */
+        buf = libusb_dev_mem_alloc(iface->dev->handle, len);
+        dev_mem = buf != NULL;
+        if (!dev_mem)
+        {
+            buf = malloc(len);
+            if (len > 0 && buf == NULL)
+                FAILURE_CLEANUP("allocate a transfer buffer");
+        }
+
+        /* Initialize the transfer */
+        libusb_fill_interrupt_transfer(*ptransfer,
+                                       iface->dev->handle, iface->int_in_ep_addr,
+                                       buf, len,
+                                       dump_iface_list_stream_cb,
+                                       (void *)iface,
+                                       timeout);
+
+        /*
+         * Ask to free the buffer when the transfer is freed, unless it's
+         * device memory, which uhd_iface_free() releases
+         */
+        if (!dev_mem)
+            (*ptransfer)->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
+    }
+
+    /*
+     * Allocate the latency probe transfer, as an interrupt OUT transfer,
+     * if the interface has the endpoint, or a Set_Report request otherwise
+     */
+    if (iface->latency != NULL)
+    {
+        transfer = libusb_alloc_transfer(0);
+        if (transfer == NULL)
+            FAILURE_CLEANUP("allocate a latency probe transfer");
+        iface->transfer_list[queue_depth] = transfer;
+
+        buf = malloc(LIBUSB_CONTROL_SETUP_SIZE + iface->latency->len);
+        if (buf == NULL)
+            FAILURE_CLEANUP("allocate a latency probe transfer buffer");
+
+        if (iface->int_out_ep_addr != 0)
+            libusb_fill_interrupt_transfer(transfer, iface->dev->handle,
+                                           iface->int_out_ep_addr,
+                                           buf, iface->latency->len,
+                                           iface_latency_cb,
+                                           (void *)iface,
+                                           UHD_IO_TIMEOUT);
+        else
+        {
+            /* Numbered reports start with the ID */
+            id = iface->plan != NULL && iface->plan->numbered
+                    ? iface->latency->report[0] : 0;
+            libusb_fill_control_setup(buf,
+                                      /* host->device, class, interface */
+                                      0x21,
+                                      /* Set_Report */
+                                      0x09,
+                                      /* Output report type, report ID */
+                                      (2 << 8) | id,
+                                      /* interface */
+                                      iface->number,
+                                      iface->latency->len);
+            libusb_fill_control_transfer(transfer, iface->dev->handle, buf,
+                                         iface_latency_cb,
+                                         (void *)iface,
+                                         UHD_IO_TIMEOUT);
+        }
+        transfer->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
+
+        /* Send the first probe right away */
+        iface->latency_next = clock_ns(CLOCK_MONOTONIC);
+    }
+
+    /* Submit first transfer requests, the probes are sent on schedule */
+    for (ptransfer = iface->transfer_list;
+         ptransfer < iface->transfer_list + queue_depth;
+         ptransfer++)
+    {
+        LIBUSB_IFACE_GUARD(libusb_submit_transfer(*ptransfer),
+                           iface, "submit a transfer");
+        iface_submitted_inc(iface);
+    }
+
+    iface->streaming = true;
+    result = true;
+
+cleanup:
+
+    return result;
+}
+
+
+/**
+ * Restart the stream of an interface whose transfers all ended, while the
+ * device is still there, clearing the endpoint halt first. Gives up after
+ * STREAM_RESTART_MAX restarts without a report in between.
+ *
+ * @param iface The interface to restart the stream of.
+ *
+ * @return True if restarted, false if the interface should be retired.
+ */
+static bool
+iface_stream_restart(uhd_iface *iface)
+{
+    enum libusb_error           err;
+    struct libusb_transfer    **ptransfer;
+
+    assert(iface->submitted == 0);
+
+    if (iface->restart_num >= STREAM_RESTART_MAX)
+    {
+        IFACE_ERROR(iface, "Stream failed %u times in a row, giving up",
+                    iface->restart_num);
+        return false;
+    }
+    iface->restart_num++;
+
+    /* Recover from a stall, harmless otherwise */
+    err = uhd_iface_clear_halt(iface);
+    if (err == LIBUSB_ERROR_NO_DEVICE)
+    {
+        mark_iface_disconnected(iface);
+        return false;
+    }
+    if (err != LIBUSB_SUCCESS)
+        LIBUSB_IFACE_FAILURE(iface, "clear the endpoint halt, ignoring");
+
+    /* Resubmit the stream transfers, but not the latency probe */
+    for (ptransfer = iface->transfer_list;
+         ptransfer < iface->transfer_list + iface->transfer_num;
+         ptransfer++)
+    {
+        if ((*ptransfer)->callback != dump_iface_list_stream_cb)
+            continue;
+        err = libusb_submit_transfer(*ptransfer);
+        if (err == LIBUSB_ERROR_NO_DEVICE)
+        {
+            mark_iface_disconnected(iface);
+            break;
+        }
+        if (err != LIBUSB_SUCCESS)
+        {
+            LIBUSB_IFACE_FAILURE(iface, "resubmit a transfer");
+            break;
+        }
+        iface_submitted_inc(iface);
+    }
+
+    if (iface->submitted == 0)
+        return false;
+
+    fprintf(stderr, "%s:Stream restarted\n", iface->addr_str);
+    return true;
+}
+
+
+/**
+ * Request cancellation of an interface's submitted stream transfers.
+ *
+ * @param iface The interface to cancel the transfers of.
+ */
+static void
+iface_stream_cancel(uhd_iface *iface)
+{
+    enum libusb_error           err;
+    struct libusb_transfer    **ptransfer;
+
+    for (ptransfer = iface->transfer_list;
+         iface->submitted > 0 &&
+         ptransfer < iface->transfer_list + iface->transfer_num;
+         ptransfer++)
+    {
+        err = libusb_cancel_transfer(*ptransfer);
+        /* Not found means this one isn't in flight, skip it */
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_NOT_FOUND)
+        {
+            LIBUSB_IFACE_FAILURE(iface, "cancel a transfer, ignoring");
+            /*
+             * XXX are we really sure
+             * the transfer won't be finished?
+             */
+            iface_submitted_dec(iface);
+        }
+    }
+}
+
+
+/**
+ * Cancel the stream transfers of every interface in a list and wait for
+ * the cancellation to complete. The list must include all interfaces
+ * with transfers in flight.
+ *
+ * @param list  The interface list to cancel the transfers of.
+ */
+static void
+iface_list_stream_cancel(uhd_iface *list)
+{
+    enum libusb_error   err;
+    uhd_iface          *iface;
+
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+        iface_stream_cancel(iface);
+
+    /* Wait for transfer cancellation */
+    while (any_submitted())
+    {
+        /* Handle cancellation events */
+        err = uhd_loop_run_once(loop);
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
+        {
+            LIBUSB_FAILURE("handle transfer cancellation events, "
+                           "aborting transfer cancellation");
+            break;
+        }
+    }
+}
+
+
+static bool
+dump_iface_list_stream(uhd_iface       *list,
+                       unsigned int     timeout,
+                       unsigned int     queue_depth,
+                       bool             stats)
+{
+    bool                result      = false;
+    enum libusb_error   err;
+    uhd_iface          *iface;
+    bool                submitted   = false;
+
+    fprintf(stderr,
+            "Starting dumping interrupt transfer stream\n"
+            "with %s timeout.\n\n",
+            format_timeout(timeout));
+
+    /* Start streaming every interface */
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+        if (!iface_stream_start(iface, timeout, queue_depth, stats))
+            goto cleanup;
+
+    /* Run the event machine */
+    submitted = any_submitted();
+    while (submitted && exit_signum == 0)
+    {
+        /* Send latency probes, if it's time */
+        schedule_iface_list_latency(list);
+
+        /* Handle the transfer events */
+        err = uhd_loop_run_once(loop);
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
+            LIBUSB_FAILURE_CLEANUP("handle transfer events");
+
+        /* Print statistics, if requested with a signal */
+        if (stats_requested)
+        {
+            stats_requested = 0;
+            print_iface_list_stats(list);
+        }
+
+        /* Print suppressed duplicate numbers, if it's time */
+        summarize_iface_list_changes(list);
+
+        /* Dump the pre-trigger history, if triggered */
+        if (trigger_requested)
+        {
+            dump_iface_list_history(list);
+            trigger_requested = 0;
+        }
+
+        /* Check if there are any submitted transfers left */
+        submitted = any_submitted();
+    }
+
+    /* If all the transfers were terminated unexpectedly */
+    if (!uhd_iface_list_empty(list) && !submitted)
+        ERROR_CLEANUP("No more interfaces to dump");
+
+    result = true;
+
+cleanup:
+
+    /* Cancel the transfers */
+    uhd_loop_set_deadline(loop, 0);
+    iface_list_stream_cancel(list);
+
+    /* Print final statistics */
+    print_iface_list_stats(list);
+    UHD_IFACE_LIST_FOR_EACH(iface, list)
+        print_iface_changes(iface, true);
+
+    /*
+     * The transfers and their buffers are freed along with the
+     * interfaces.
+     */
+
+    return result;
+}
+
+
+/** Hotplug dumping state */
+typedef struct hotplug_state {
+    uint8_t             bus_num;            /**< Bus number to match */
+    uint8_t             dev_addr;           /**< Device address to match */
+    int                 iface_num;          /**< Interface number to match */
+    bool                dump_descriptor;    /**< Dump report descriptors */
+    bool                dump_stream;        /**< Dump interrupt streams */
+    unsigned int        stream_timeout;     /**< Stream transfer timeout,
+                                                 ms */
+    unsigned int        stream_queue;       /**< Stream transfers per
+                                                 interface */
+    bool                stream_stats;       /**< Collect stream
+                                                 statistics */
+    libusb_device     **arrived_list;       /**< Referenced devices which
+                                                 arrived, but weren't set
+                                                 up yet, in arrival order */
+    size_t              arrived_num;        /**< Number of arrived
+                                                 devices */
+    size_t              arrived_size;       /**< Arrived list capacity */
+    uhd_dev            *dev_list;           /**< Open devices */
+    uhd_iface          *iface_list;         /**< Their interfaces */
+} hotplug_state;
+
+
+/**
+ * Hotplug callback: queue arrived devices for setup and mark interfaces
+ * of departed ones disconnected. Nothing doing I/O may be done here, as
+ * it is called from within event handling.
+ */
+static int LIBUSB_CALL
+hotplug_cb(libusb_context          *ctx,
+           libusb_device           *lusb_dev,
+           libusb_hotplug_event     event,
+           void                    *user_data)
+{
+    hotplug_state      *hs          = (hotplug_state *)user_data;
+    libusb_device     **list;
+    size_t              size;
+    size_t              idx;
+    uhd_iface          *iface;
+
+    (void)ctx;
+
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+    {
+        /* Skip devices not matching bus_num/dev_addr mask */
+        if ((hs->bus_num != UHD_BUS_NUM_ANY &&
+             libusb_get_bus_number(lusb_dev) != hs->bus_num) ||
+            (hs->dev_addr != UHD_DEV_ADDR_ANY &&
+             libusb_get_device_address(lusb_dev) != hs->dev_addr))
+            return 0;
+
+        /* Grow the arrived device list, if needed */
+        if (hs->arrived_num == hs->arrived_size)
+        {
+            size = hs->arrived_size == 0 ? 16 : hs->arrived_size * 2;
+            list = realloc(hs->arrived_list, sizeof(*list) * size);
+            if (list == NULL)
+            {
+                GENERIC_FAILURE("queue an arrived device, skipping it");
+                return 0;
+            }
+            hs->arrived_list = list;
+            hs->arrived_size = size;
+        }
 
-    FRACTION(0, "hour", h);
-    FRACTION(h, "minute", m);
-    FRACTION(h + m, "second", s);
-    FRACTION(h + m + s, "millisecond", ms);
+        hs->arrived_list[hs->arrived_num++] = libusb_ref_device(lusb_dev);
+    }
+    else
+    {
+        /* Forget the device if it wasn't set up yet */
+        for (idx = 0; idx < hs->arrived_num; idx++)
+            if (hs->arrived_list[idx] == lusb_dev)
+            {
+                libusb_unref_device(lusb_dev);
+                hs->arrived_num--;
+                memmove(hs->arrived_list + idx, hs->arrived_list + idx + 1,
+                        sizeof(*hs->arrived_list) * (hs->arrived_num - idx));
+                break;
+            }
 
-#undef FRACTION
+        /* Let its interfaces be retired */
+        UHD_IFACE_LIST_FOR_EACH(iface, hs->iface_list)
+            if (libusb_get_device(iface->dev->handle) == lusb_dev)
+                mark_iface_disconnected(iface);
+    }
 
-    return buf;
+    return 0;
 }
 
 
-static const char *
-format_timeout(unsigned int i)
+/**
+ * Check if a device has any HID interfaces in its active configuration,
+ * without opening it.
+ *
+ * @param lusb_dev  The device to check.
+ *
+ * @return True if the device has HID interfaces, false otherwise.
+ */
+static bool
+dev_has_hid(libusb_device *lusb_dev)
 {
-    return (i == 0) ? "infinite" : format_time_interval(i);
+    struct libusb_config_descriptor    *config;
+    const struct libusb_interface      *lusb_iface;
+    bool                                found       = false;
+
+    if (libusb_get_active_config_descriptor(lusb_dev,
+                                            &config) != LIBUSB_SUCCESS)
+        return false;
+
+    for (lusb_iface = config->interface;
+         !found &&
+         lusb_iface - config->interface < config->bNumInterfaces;
+         lusb_iface++)
+        found = lusb_iface->num_altsetting > 0 &&
+                lusb_iface->altsetting->bInterfaceClass == LIBUSB_CLASS_HID;
+
+    libusb_free_config_descriptor(config);
+
+    return found;
 }
 
 
-static bool
-dump_iface_list_stream(libusb_context  *ctx,
-                       uhd_iface       *list,
-                       unsigned int     timeout)
+/**
+ * Set up an arrived device: open it, claim its matching HID interfaces,
+ * dump their descriptors and start streaming them, as requested.
+ * Interfaces failing setup are left to be retired.
+ *
+ * @param hs        Hotplug dumping state.
+ * @param lusb_dev  The arrived device.
+ */
+static void
+hotplug_add(hotplug_state *hs, libusb_device *lusb_dev)
 {
-    bool                        result              = false;
-    enum libusb_error           err;
-    size_t                      transfer_num        = 0;
-    struct libusb_transfer    **transfer_list       = NULL;
-    struct libusb_transfer    **ptransfer;
-    uhd_iface                  *iface;
-    bool                        submitted           = false;
+    enum libusb_error   err;
+    uhd_dev            *dev     = NULL;
+    uhd_iface          *list    = NULL;
+    uhd_iface          *last;
+    uhd_iface          *iface;
 
-    fprintf(stderr,
-            "Starting dumping interrupt transfer stream\n"
-            "with %s timeout.\n\n",
-            format_timeout(timeout));
+    if (!dev_has_hid(lusb_dev))
+        return;
 
-    UHD_IFACE_LIST_FOR_EACH(iface, list)
-    {
-        /* Set report protocol */
-        LIBUSB_IFACE_GUARD(uhd_iface_set_protocol(iface, true,
-                                                  UHD_IO_TIMEOUT),
-                           iface, "set report protocol");
-        /* Set infinite idle duration */
-        LIBUSB_IFACE_GUARD(uhd_iface_set_idle(iface, 0, UHD_IO_TIMEOUT),
-                           iface, "set infinite idle duration");
-    }
+    LIBUSB_GUARD(uhd_dev_open(lusb_dev, &dev),
+                 "open device %.3hhu:%.3hhu",
+                 libusb_get_bus_number(lusb_dev),
+                 libusb_get_device_address(lusb_dev));
 
-    /* Calculate number of interfaces and thus transfers */
-    transfer_num = uhd_iface_list_len(list);
+    /* Retrieve the list of the device HID interfaces */
+    LIBUSB_GUARD(uhd_iface_list_new(dev, &list), "find HID interfaces");
 
-    /* Allocate transfer list */
-    transfer_list = malloc(sizeof(*transfer_list) * transfer_num);
-    if (transfer_list == NULL)
-        FAILURE_CLEANUP("allocate transfer list");
+    /* Filter the interface list by specified interface number */
+    if (hs->iface_num != UHD_IFACE_NUM_ANY)
+        list = uhd_iface_list_fltr_by_num(list, hs->iface_num);
 
-    /* Zero transfer list */
-    for (ptransfer = transfer_list;
-         (size_t)(ptransfer - transfer_list) < transfer_num;
-         ptransfer++)
-        *ptransfer = NULL;
+    if (uhd_iface_list_empty(list))
+        goto cleanup;
 
-    /* Allocate transfers */
-    for (ptransfer = transfer_list;
-         (size_t)(ptransfer - transfer_list) < transfer_num;
-         ptransfer++)
+    /* Hand the device and the interfaces over to the state */
+    dev->next = hs->dev_list;
+    hs->dev_list = dev;
+    dev = NULL;
+    for (last = list; last->next != NULL; last = last->next);
+    last->next = hs->iface_list;
+    hs->iface_list = list;
+
+    for (iface = list; ; iface = iface->next)
     {
-        *ptransfer = libusb_alloc_transfer(0);
-        if (*ptransfer == NULL)
-            FAILURE_CLEANUP("allocate a transfer");
-        /*
-         * Set user_data to NULL explicitly, since libusb_alloc_transfer
-         * does memset to zero only and zero is not NULL, strictly speaking.
-         */
-        (*ptransfer)->user_data = NULL;
+        fprintf(stderr, "%s:Interface arrived\n", iface->addr_str);
+
+        err = uhd_iface_detach(iface);
+        if (err != LIBUSB_SUCCESS)
+            LIBUSB_IFACE_FAILURE(iface, "detach from the kernel driver");
+        else
+        {
+            err = uhd_iface_claim(iface);
+            if (err != LIBUSB_SUCCESS)
+                LIBUSB_IFACE_FAILURE(iface, "claim");
+            else if ((!hs->dump_descriptor ||
+                      dump_iface_descriptor(iface)) &&
+                     hs->dump_stream)
+                iface_stream_start(iface,
+                                   hs->stream_timeout,
+                                   hs->stream_queue,
+                                   hs->stream_stats);
+        }
+
+        if (iface == last)
+            break;
     }
 
-    /* Initialize the transfers as interrupt transfers */
-    for (ptransfer = transfer_list, iface = list;
-         (size_t)(ptransfer - transfer_list) < transfer_num;
-         ptransfer++, iface = iface->next)
-    {
-        void           *buf;
-        const size_t    len = iface->int_in_ep_maxp;
+    /* Let the interfaces which failed be retired */
+    retire_pending = true;
 
-        /* Allocate the transfer buffer */
-        buf = malloc(len);
-        if (len > 0 && buf == NULL)
-            FAILURE_CLEANUP("allocate a transfer buffer");
+cleanup:
 
-        /* Initialize the transfer */
-        libusb_fill_interrupt_transfer(*ptransfer,
-                                       iface->dev->handle, iface->int_in_ep_addr,
-                                       buf, len,
-                                       dump_iface_list_stream_cb,
-                                       (void *)iface,
-                                       timeout);
+    uhd_dev_close(dev);
+}
 
-        /* Ask to free the buffer when the transfer is freed */
-        (*ptransfer)->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
-    }
 
-    /* Submit first transfer requests */
-    for (ptransfer = transfer_list;
-         (size_t)(ptransfer - transfer_list) < transfer_num;
-         ptransfer++)
+/**
+ * Retire interfaces without transfers in flight, cancelling those of
+ * disconnected ones first, and close devices left without interfaces.
+ * Streams which merely ended are restarted instead, while restarting.
+ *
+ * @param hs    Hotplug dumping state.
+ */
+static void
+hotplug_retire(hotplug_state *hs)
+{
+    enum libusb_error   err;
+    uhd_iface         **piface;
+    uhd_iface          *iface;
+    uhd_dev           **pdev;
+    uhd_dev            *dev;
+
+    retire_pending = false;
+
+    /* Dump the pre-trigger history first, if a disconnection triggered it */
+    if (trigger_requested)
     {
-        LIBUSB_GUARD(libusb_submit_transfer(*ptransfer),
-                     "submit a transfer");
-        /* Set interface "has transfer submitted" flag */
-        ((uhd_iface *)(*ptransfer)->user_data)->submitted = true;
-        /* Set "have any submitted transfers" flag */
-        submitted = true;
+        dump_iface_list_history(hs->iface_list);
+        trigger_requested = 0;
     }
 
-    /* Run the event machine */
-    while (submitted && exit_signum == 0)
+    for (piface = &hs->iface_list; (iface = *piface) != NULL;)
     {
-        /* Handle the transfer events */
-        err = libusb_handle_events(ctx);
-        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
-            LIBUSB_FAILURE_CLEANUP("handle transfer events");
+        if (iface->disconnected)
+            iface_stream_cancel(iface);
 
-        /* Check if there are any submitted transfers left */
-        submitted = false;
-        for (ptransfer = transfer_list;
-             (size_t)(ptransfer - transfer_list) < transfer_num;
-             ptransfer++)
+        if (iface->submitted > 0 ||
+            (stream_restart && iface->streaming && !iface->disconnected &&
+             iface_stream_restart(iface)))
         {
-            iface = (uhd_iface *)(*ptransfer)->user_data;
+            piface = &iface->next;
+            continue;
+        }
 
-            if (iface != NULL && iface->submitted)
-                submitted = true;
+        /* Don't complain about the device being gone */
+        if (iface->claimed)
+        {
+            err = uhd_iface_release(iface);
+            if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_NO_DEVICE)
+                LIBUSB_IFACE_FAILURE(iface, "release");
         }
-    }
 
-    /* If all the transfers were terminated unexpectedly */
-    if (transfer_num > 0 && !submitted)
-        ERROR_CLEANUP("No more interfaces to dump");
+        err = uhd_iface_attach(iface);
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_NO_DEVICE)
+            LIBUSB_IFACE_FAILURE(iface, "attach to the kernel driver");
 
-    result = true;
+        print_iface_stats(iface);
+        print_iface_changes(iface, true);
+        fprintf(stderr, "%s:Interface retired\n", iface->addr_str);
 
-cleanup:
+        *piface = iface->next;
+        uhd_iface_free(iface);
+    }
 
-    /* Cancel the transfers */
-    if (submitted)
+    for (pdev = &hs->dev_list; (dev = *pdev) != NULL;)
     {
-        submitted = false;
-        for (ptransfer = transfer_list;
-             (size_t)(ptransfer - transfer_list) < transfer_num;
-             ptransfer++)
-        {
-            iface = (uhd_iface *)(*ptransfer)->user_data;
+        UHD_IFACE_LIST_FOR_EACH(iface, hs->iface_list)
+            if (iface->dev == dev)
+                break;
 
-            if (iface != NULL && iface->submitted)
-            {
-                err = libusb_cancel_transfer(*ptransfer);
-                if (err == LIBUSB_SUCCESS)
-                    submitted = true;
-                else
-                {
-                    LIBUSB_FAILURE("cancel a transfer, ignoring");
-                    /*
-                     * XXX are we really sure
-                     * the transfer won't be finished?
-                     */
-                    iface->submitted = false;
-                }
-            }
+        if (iface != NULL)
+        {
+            pdev = &dev->next;
+            continue;
         }
+
+        *pdev = dev->next;
+        uhd_dev_close(dev);
     }
+}
 
-    /* Wait for transfer cancellation */
-    while (submitted)
+
+/**
+ * Dump interfaces of matching devices as they are connected, retiring
+ * them as they are disconnected, until a signal is received.
+ *
+ * @param ctx   The libusb context to use.
+ * @param hs    Hotplug dumping state, with the settings filled in.
+ * @param vid   Vendor ID to match, or UHD_VID_ANY.
+ * @param pid   Product ID to match, or UHD_PID_ANY.
+ *
+ * @return True if dumped successfully, false otherwise.
+ */
+static bool
+dump_hotplug(libusb_context    *ctx,
+             hotplug_state     *hs,
+             uint16_t           vid,
+             uint16_t           pid)
+{
+    bool                            result      = false;
+    enum libusb_error               err;
+    libusb_hotplug_callback_handle  handle;
+    bool                            registered  = false;
+    libusb_device                  *lusb_dev;
+
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+        ERROR_CLEANUP("Hotplug is not supported on this platform");
+
+    if (hs->dump_stream)
+        fprintf(stderr,
+                "Starting dumping interrupt transfer streams of\n"
+                "connected devices with %s timeout.\n\n",
+                format_timeout(hs->stream_timeout));
+
+    /* Register for arrivals and departures, enumerating present devices */
+    LIBUSB_GUARD(libusb_hotplug_register_callback(
+                    ctx,
+                    LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+                    LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+                    LIBUSB_HOTPLUG_ENUMERATE,
+                    vid == UHD_VID_ANY ? LIBUSB_HOTPLUG_MATCH_ANY : vid,
+                    pid == UHD_PID_ANY ? LIBUSB_HOTPLUG_MATCH_ANY : pid,
+                    LIBUSB_HOTPLUG_MATCH_ANY,
+                    hotplug_cb, hs, &handle),
+                 "register hotplug callback");
+    registered = true;
+
+    /* Keep the streams going until the devices are disconnected */
+    stream_restart = true;
+
+    /* Run the event machine */
+    while (exit_signum == 0)
     {
-        /* Handle cancellation events */
-        err = libusb_handle_events(ctx);
-        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
+        /*
+         * Set up the arrived devices in order, one at a time, as the
+         * control transfers done meanwhile can run the hotplug callback.
+         */
+        while (hs->arrived_num > 0 && exit_signum == 0)
         {
-            LIBUSB_FAILURE("handle transfer cancellation events, "
-                           "aborting transfer cancellation");
-            break;
+            lusb_dev = hs->arrived_list[0];
+            hs->arrived_num--;
+            memmove(hs->arrived_list, hs->arrived_list + 1,
+                    sizeof(*hs->arrived_list) * hs->arrived_num);
+            hotplug_add(hs, lusb_dev);
+            libusb_unref_device(lusb_dev);
         }
 
-        /* Check if there are any submitted transfers left */
-        submitted = false;
-        for (ptransfer = transfer_list;
-             (size_t)(ptransfer - transfer_list) < transfer_num;
-             ptransfer++)
+        /* Retire disconnected and finished interfaces, if any */
+        if (retire_pending)
+            hotplug_retire(hs);
+
+        /* Send latency probes, if it's time */
+        schedule_iface_list_latency(hs->iface_list);
+
+        /* Handle the transfer and hotplug events */
+        err = uhd_loop_run_once(loop);
+        if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED)
+            LIBUSB_FAILURE_CLEANUP("handle transfer events");
+
+        /* Print statistics, if requested with a signal */
+        if (stats_requested)
         {
-            iface = (uhd_iface *)(*ptransfer)->user_data;
+            stats_requested = 0;
+            print_iface_list_stats(hs->iface_list);
+        }
 
-            if (iface != NULL && iface->submitted)
-                submitted = true;
+        /* Print suppressed duplicate numbers, if it's time */
+        summarize_iface_list_changes(hs->iface_list);
+
+        /* Dump the pre-trigger history, if triggered */
+        if (trigger_requested)
+        {
+            dump_iface_list_history(hs->iface_list);
+            trigger_requested = 0;
         }
     }
 
-    /*
-     * Free transfer list along with non-submitted transfers and their
-     * buffers.
-     */
-    if (transfer_list != NULL)
-    {
-        for (ptransfer = transfer_list;
-             (size_t)(ptransfer - transfer_list) < transfer_num;
-             ptransfer++)
-        {
-            iface = (uhd_iface *)(*ptransfer)->user_data;
+    result = true;
 
-            /*
-             * Only free a transfer if it is not submitted. Better leak some
-             * memory than have some important memory overwritten.
-             */
-            if (iface == NULL || !iface->submitted)
-                libusb_free_transfer(*ptransfer);
-        }
+cleanup:
 
-        free(transfer_list);
-    }
+    if (registered)
+        libusb_hotplug_deregister_callback(ctx, handle);
+
+    /* Forget the devices which weren't set up */
+    while (hs->arrived_num > 0)
+        libusb_unref_device(hs->arrived_list[--hs->arrived_num]);
+    free(hs->arrived_list);
+    hs->arrived_list = NULL;
+    hs->arrived_size = 0;
+
+    /* Cancel the transfers and retire all the interfaces */
+    stream_restart = false;
+    uhd_loop_set_deadline(loop, 0);
+    iface_list_stream_cancel(hs->iface_list);
+    hotplug_retire(hs);
+
+    /* Free whatever couldn't be retired */
+    uhd_iface_list_free(hs->iface_list);
+    hs->iface_list = NULL;
+    uhd_dev_list_close(hs->dev_list);
+    hs->dev_list = NULL;
 
     return result;
 }
@@ -490,6 +2382,9 @@ static int
 run(bool            dump_descriptor,
     bool            dump_stream,
     unsigned int    stream_timeout,
+    unsigned int    stream_queue,
+    bool            stream_stats,
+    bool            hotplug,
     uint8_t         bus_num,
     uint8_t         dev_addr,
     uint16_t        vid,
@@ -502,6 +2397,7 @@ run(bool            dump_descriptor,
     uhd_dev            *dev_list    = NULL;
     uhd_iface          *iface_list  = NULL;
     uhd_iface          *iface;
+    uhd_loop           *old_loop;
 
     /* Create libusb context */
     LIBUSB_GUARD(libusb_init(&ctx), "create libusb context");
@@ -509,6 +2405,27 @@ run(bool            dump_descriptor,
     /* Set libusb debug level to informational only */
     libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
 
+    /* Create the event loop */
+    loop = uhd_loop_new(ctx);
+    if (loop == NULL)
+        FAILURE_CLEANUP("create event loop");
+
+    /* Dump devices as they come and go, if requested */
+    if (hotplug)
+    {
+        hotplug_state   hs  = {.bus_num         = bus_num,
+                               .dev_addr        = dev_addr,
+                               .iface_num       = iface_num,
+                               .dump_descriptor = dump_descriptor,
+                               .dump_stream     = dump_stream,
+                               .stream_timeout  = stream_timeout,
+                               .stream_queue    = stream_queue,
+                               .stream_stats    = stream_stats};
+
+        result = dump_hotplug(ctx, &hs, vid, pid) ? 0 : 1;
+        goto cleanup;
+    }
+
     /* Open device list */
     LIBUSB_GUARD(uhd_dev_list_open(ctx, bus_num, dev_addr,
                                    vid, pid, &dev_list),
@@ -537,8 +2454,10 @@ run(bool            dump_descriptor,
 
     /* Run with the prepared interface list */
     result = (!dump_descriptor || dump_iface_list_descriptor(iface_list)) &&
-             (!dump_stream || dump_iface_list_stream(ctx, iface_list,
-                                                     stream_timeout))
+             (!dump_stream || dump_iface_list_stream(iface_list,
+                                                     stream_timeout,
+                                                     stream_queue,
+                                                     stream_stats))
                ? 0
                : 1;
 
@@ -562,6 +2481,11 @@ cleanup:
     /* Close the device list */
     uhd_dev_list_close(dev_list);
 
+    /* Destroy the event loop, after taking it from the signal handlers */
+    old_loop = loop;
+    __atomic_store_n(&loop, NULL, __ATOMIC_SEQ_CST);
+    uhd_loop_free(old_loop);
+
     /* Destroy the libusb context */
     if (ctx != NULL)
         libusb_exit(ctx);
@@ -765,6 +2689,37 @@ parse_timeout(const char   *str,
 }
 
 
+static bool
+parse_queue_depth(const char   *str,
+                  unsigned int *pdepth)
+{
+    long        depth;
+    const char *p;
+    char       *end;
+
+    assert(str != NULL);
+
+    p = str;
+
+    /* Skip space (prevent strtol doing so) */
+    while (isspace((int)*p))
+        p++;
+
+    /* Extract queue depth */
+    errno = 0;
+    depth = strtol(p, &end, 10);
+    if (errno != 0 || end == p ||
+        depth < 1 || depth > UHD_STREAM_QUEUE_MAX)
+        return false;
+
+    /* Output queue depth */
+    if (pdepth != NULL)
+        *pdepth = depth;
+
+    return true;
+}
+
+
 static bool
 version(FILE *stream)
 {
@@ -807,17 +2762,69 @@ usage(FILE *stream, const char *name)
 "                                   abbreviated\n"
 "\n"
 "  -t, --stream-timeout=NUMBER      stream interrupt transfer timeout, ms;\n"
-"                                   zero means infinity\n"
+"                                   zero means infinity, the default\n"
+"                                   with --hotplug\n"
+"  -q, --stream-queue=NUMBER        number of interrupt transfers kept\n"
+"                                   submitted per interface (1-64)\n"
 "  -p, --stream-paused              start with the stream dump output\n"
 "                                   paused\n"
 "  -f, --stream-feedback            enable stream dumping feedback: for\n"
 "                                   every transfer dumped a dot is\n"
 "                                   printed to stderr\n"
+"  -S, --stream-stats               collect per-interface report rate and\n"
+"                                   inter-arrival time statistics, print\n"
+"                                   them to stderr on exit and on SIGQUIT\n"
+"  -C, --stream-changes=NUMBER      only dump stream reports differing\n"
+"                                   from the previous one with the same\n"
+"                                   report ID, print numbers of\n"
+"                                   suppressed duplicates every NUMBER\n"
+"                                   seconds and on exit; zero means\n"
+"                                   only on exit\n"
+"  -P, --pretrigger=NUMBER          hold the stream reports of the last\n"
+"                                   NUMBER seconds in memory, dumping\n"
+"                                   them only when triggered\n"
+"  -T, --trigger=SPEC               dump the held reports when a report\n"
+"                                   matches SPEC: \"bytes=HEX[@OFFSET]\",\n"
+"                                   \"id=NUMBER\" or \"gap=NUMBER\" (ms);\n"
+"                                   can be repeated, needs -P\n"
+"  -L, --latency=HEX[@OFFSET]       measure round-trip latency: send the\n"
+"                                   output report HEX, incrementing the\n"
+"                                   byte at OFFSET each time, if given,\n"
+"                                   and time the stream report echoing\n"
+"                                   it; print the results to stderr on\n"
+"                                   exit and on SIGQUIT, implies\n"
+"                                   --entity=stream\n"
+"  -r, --latency-rate=NUMBER        latency probes sent per second\n"
+"                                   (1-1000)\n"
+"  -Y, --latency-replay             measure round-trip latency of the\n"
+"                                   probes in a binary capture read from\n"
+"                                   stdin and exit\n"
+"  -H, --hotplug                    keep running, dumping interfaces of\n"
+"                                   matching devices as they are\n"
+"                                   connected, until interrupted\n"
+"  -D, --decode                     decode stream reports into usage\n"
+"                                   values using the report descriptor,\n"
+"                                   text format only\n"
+"  -F, --format=STRING              output format: either \"text\" or\n"
+"                                   \"binary\"; value can be abbreviated\n"
+"  -c, --convert                    convert a binary capture read from\n"
+"                                   stdin to text and exit\n"
+"  -R, --ring=NAME                  publish binary capture records into\n"
+"                                   shared memory ring NAME in /dev/shm,\n"
+"                                   instead of writing to stdout\n"
+"  -o, --output-overflow=STRING     what to do with output which can't be\n"
+"                                   written fast enough: either \"block\"\n"
+"                                   or \"drop\"; value can be abbreviated\n"
 "\n"
-"Default options: --stream-timeout=60000 --entity=descriptor\n"
+"Default options: --stream-timeout=60000 (0 with -H) --stream-queue=1\n"
+"                 --output-overflow=block --format=text\n"
+"                 --entity=descriptor --latency-rate=10\n"
 "\n"
 "Signals:\n"
 "  USR1/USR2                        pause/resume the stream dump output\n"
+"  QUIT                             print stream statistics, with -S,\n"
+"                                   and round-trip latency, with -L\n"
+"  HUP                              dump the held reports, with -P\n"
 "\n",
             name) >= 0;
 }
@@ -833,8 +2840,22 @@ typedef enum opt_val {
     OPT_VAL_INTERFACE       = 'i',
     OPT_VAL_ENTITY          = 'e',
     OPT_VAL_STREAM_TIMEOUT  = 't',
+    OPT_VAL_STREAM_QUEUE    = 'q',
     OPT_VAL_STREAM_PAUSED   = 'p',
     OPT_VAL_STREAM_FEEDBACK = 'f',
+    OPT_VAL_STREAM_STATS    = 'S',
+    OPT_VAL_STREAM_CHANGES  = 'C',
+    OPT_VAL_PRETRIGGER      = 'P',
+    OPT_VAL_TRIGGER         = 'T',
+    OPT_VAL_LATENCY         = 'L',
+    OPT_VAL_LATENCY_RATE    = 'r',
+    OPT_VAL_LATENCY_REPLAY  = 'Y',
+    OPT_VAL_HOTPLUG         = 'H',
+    OPT_VAL_DECODE          = 'D',
+    OPT_VAL_OUTPUT_OVERFLOW = 'o',
+    OPT_VAL_FORMAT          = 'F',
+    OPT_VAL_CONVERT         = 'c',
+    OPT_VAL_RING            = 'R',
 } opt_val;
 
 
@@ -867,6 +2888,10 @@ static const struct option long_opt_list[] = {
      .name      = "stream-timeout",
      .has_arg   = required_argument,
      .flag      = NULL},
+    {.val       = OPT_VAL_STREAM_QUEUE,
+     .name      = "stream-queue",
+     .has_arg   = required_argument,
+     .flag      = NULL},
     {.val       = OPT_VAL_STREAM_PAUSED,
      .name      = "stream-paused",
      .has_arg   = no_argument,
@@ -875,6 +2900,58 @@ static const struct option long_opt_list[] = {
      .name      = "stream-feedback",
      .has_arg   = no_argument,
      .flag      = NULL},
+    {.val       = OPT_VAL_STREAM_STATS,
+     .name      = "stream-stats",
+     .has_arg   = no_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_STREAM_CHANGES,
+     .name      = "stream-changes",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_PRETRIGGER,
+     .name      = "pretrigger",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_TRIGGER,
+     .name      = "trigger",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_LATENCY,
+     .name      = "latency",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_LATENCY_RATE,
+     .name      = "latency-rate",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_LATENCY_REPLAY,
+     .name      = "latency-replay",
+     .has_arg   = no_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_HOTPLUG,
+     .name      = "hotplug",
+     .has_arg   = no_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_DECODE,
+     .name      = "decode",
+     .has_arg   = no_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_OUTPUT_OVERFLOW,
+     .name      = "output-overflow",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_FORMAT,
+     .name      = "format",
+     .has_arg   = required_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_CONVERT,
+     .name      = "convert",
+     .has_arg   = no_argument,
+     .flag      = NULL},
+    {.val       = OPT_VAL_RING,
+     .name      = "ring",
+     .has_arg   = required_argument,
+     .flag      = NULL},
     {.val       = 0,
      .name      = NULL,
      .has_arg   = 0,
@@ -882,7 +2959,8 @@ static const struct option long_opt_list[] = {
 };
 
 
-static const char  *short_opt_list = "hvs:a:d:m:i:e:t:pf";
+static const char  *short_opt_list =
+                        "hvs:a:d:m:i:e:t:q:pfSC:P:T:L:r:YHDo:F:cR:";
 
 
 int
@@ -905,6 +2983,18 @@ main(int argc, char **argv)
     bool                dump_descriptor = true;
     bool                dump_stream     = false;
     unsigned int        stream_timeout  = 60000;
+    bool                timeout_set     = false;
+    unsigned int        stream_queue    = 1;
+    bool                stream_stats    = false;
+    bool                hotplug         = false;
+    unsigned int        pretrigger_s    = 0;
+    unsigned int        latency_rate    = 10;
+    bool                latency_replay  = false;
+    uhd_writer_overflow overflow        = UHD_WRITER_OVERFLOW_BLOCK;
+    bool                convert_capture = false;
+    const char         *ring_name       = NULL;
+    uint8_t             header[UHD_CAPTURE_HEADER_LEN];
+    uint64_t            monotonic;
 
     struct sigaction    sa;
 
@@ -977,6 +3067,11 @@ main(int argc, char **argv)
             case OPT_VAL_STREAM_TIMEOUT:
                 if (!parse_timeout(optarg, &stream_timeout))
                     USAGE_ERROR("Invalid stream timeout \"%s\"", optarg);
+                timeout_set = true;
+                break;
+            case OPT_VAL_STREAM_QUEUE:
+                if (!parse_queue_depth(optarg, &stream_queue))
+                    USAGE_ERROR("Invalid stream queue depth \"%s\"", optarg);
                 break;
             case OPT_VAL_STREAM_PAUSED:
                 stream_paused = 1;
@@ -984,6 +3079,71 @@ main(int argc, char **argv)
             case OPT_VAL_STREAM_FEEDBACK:
                 stream_feedback = 1;
                 break;
+            case OPT_VAL_STREAM_STATS:
+                stream_stats = true;
+                break;
+            case OPT_VAL_STREAM_CHANGES:
+                if (!parse_timeout(optarg, &changes_period))
+                    USAGE_ERROR("Invalid stream changes summary period "
+                                "\"%s\"", optarg);
+                changes_only = true;
+                break;
+            case OPT_VAL_PRETRIGGER:
+                if (!parse_timeout(optarg, &pretrigger_s) ||
+                    pretrigger_s == 0)
+                    USAGE_ERROR("Invalid pre-trigger period \"%s\"",
+                                optarg);
+                pretrigger = (uint64_t)pretrigger_s * 1000000000;
+                break;
+            case OPT_VAL_TRIGGER:
+                if (!uhd_trigger_parse(optarg, &trigger_list))
+                    USAGE_ERROR("Invalid trigger \"%s\"", optarg);
+                break;
+            case OPT_VAL_LATENCY:
+                uhd_latency_free(latency);
+                latency = uhd_latency_parse(optarg);
+                if (latency == NULL)
+                    USAGE_ERROR("Invalid latency probe \"%s\"", optarg);
+                break;
+            case OPT_VAL_LATENCY_RATE:
+                if (!parse_timeout(optarg, &latency_rate) ||
+                    latency_rate < 1 || latency_rate > 1000)
+                    USAGE_ERROR("Invalid latency probe rate \"%s\"", optarg);
+                break;
+            case OPT_VAL_LATENCY_REPLAY:
+                latency_replay = true;
+                break;
+            case OPT_VAL_HOTPLUG:
+                hotplug = true;
+                break;
+            case OPT_VAL_DECODE:
+                decode = true;
+                break;
+            case OPT_VAL_OUTPUT_OVERFLOW:
+                if (strncmp(optarg, "block", strlen(optarg)) == 0)
+                    overflow = UHD_WRITER_OVERFLOW_BLOCK;
+                else if (strncmp(optarg, "drop", strlen(optarg)) == 0)
+                    overflow = UHD_WRITER_OVERFLOW_DROP;
+                else
+                    USAGE_ERROR("Unknown output overflow policy \"%s\"",
+                                optarg);
+                break;
+            case OPT_VAL_FORMAT:
+                if (strncmp(optarg, "text", strlen(optarg)) == 0)
+                    format = DUMP_FORMAT_TEXT;
+                else if (strncmp(optarg, "binary", strlen(optarg)) == 0)
+                    format = DUMP_FORMAT_BINARY;
+                else
+                    USAGE_ERROR("Unknown output format \"%s\"", optarg);
+                break;
+            case OPT_VAL_CONVERT:
+                convert_capture = true;
+                break;
+            case OPT_VAL_RING:
+                if (*optarg == '\0' || strchr(optarg + 1, '/') != NULL)
+                    USAGE_ERROR("Invalid ring name \"%s\"", optarg);
+                ring_name = optarg;
+                break;
             case '?':
                 usage(stderr, name);
                 return 1;
@@ -997,6 +3157,43 @@ main(int argc, char **argv)
     if (optind < argc)
         USAGE_ERROR("Positional arguments are not accepted");
 
+    /* Idle devices shouldn't time out of running until interrupted */
+    if (hotplug && !timeout_set)
+        stream_timeout = 0;
+
+    if (convert_capture && format != DUMP_FORMAT_TEXT)
+        USAGE_ERROR("Binary captures can only be converted to text");
+
+    if (trigger_list != NULL && pretrigger == 0)
+        USAGE_ERROR("Triggers can only be used with --pretrigger");
+
+    if (latency_replay && (convert_capture || latency != NULL))
+        USAGE_ERROR("Latency replay can't be combined with --convert "
+                    "or --latency");
+
+    if (convert_capture && ring_name != NULL)
+        USAGE_ERROR("Binary captures can only be converted to stdout");
+
+    if (decode && (format != DUMP_FORMAT_TEXT || ring_name != NULL))
+        USAGE_ERROR("Reports can only be decoded in the text format");
+
+    if (format == DUMP_FORMAT_BINARY && ring_name == NULL &&
+        isatty(STDOUT_FILENO))
+        USAGE_ERROR("Refusing to write a binary capture to a terminal");
+
+    if (format == DUMP_FORMAT_BINARY || ring_name != NULL)
+    {
+        /* Binary captures always start with the report descriptors */
+        dump_descriptor = true;
+    }
+
+    if (latency != NULL)
+    {
+        /* The probes are answered in the stream */
+        dump_stream = true;
+        latency_period = 1000000000 / latency_rate;
+    }
+
     /*
      * Setup signal handlers
      */
@@ -1030,12 +3227,93 @@ main(int argc, char **argv)
     sa.sa_handler = stream_resume_sighandler;
     sigaction(SIGUSR2, &sa, NULL);
 
+    /* Setup SIGQUIT to print statistics, if collected */
+    if (stream_stats || latency != NULL)
+    {
+        sa.sa_handler = stats_sighandler;
+        sa.sa_flags = 0;    /* NOTE: no SA_RESTART on purpose */
+        sigaction(SIGQUIT, &sa, NULL);
+    }
+
+    /* Setup SIGHUP to dump the pre-trigger history, if held */
+    if (pretrigger != 0)
+    {
+        sa.sa_handler = trigger_sighandler;
+        sa.sa_flags = 0;    /* NOTE: no SA_RESTART on purpose */
+        sigaction(SIGHUP, &sa, NULL);
+    }
+
     /* Make stdout buffered - we will flush it explicitly */
     setbuf(stdout, NULL);
 
+    /* Replay doesn't dump anything, only prints the results */
+    if (latency_replay)
+        return replay_latency(stdin) ? 0 : 1;
+
+    /* Start the output writer thread */
+    /* Text output is formatted by the writer thread */
+    if (format == DUMP_FORMAT_TEXT && ring_name == NULL)
+        writer = uhd_writer_new(STDOUT_FILENO, UHD_WRITER_SIZE, overflow,
+                                dump_frame_format, NULL);
+    else
+        writer = uhd_writer_new(STDOUT_FILENO, UHD_WRITER_SIZE, overflow,
+                                NULL, NULL);
+    if (writer == NULL)
+    {
+        GENERIC_FAILURE("start the output writer");
+        return 1;
+    }
+
+    if (convert_capture)
+    {
+        result = convert(stdin) ? 0 : 1;
+        uhd_writer_free(writer);
+        return result;
+    }
+
+    /* Remember how to turn monotonic timestamps into wall-clock time */
+    monotonic = clock_ns(CLOCK_MONOTONIC);
+    realtime_offset = clock_ns(CLOCK_REALTIME) - monotonic;
+
+    if (ring_name != NULL)
+    {
+        ring = uhd_ring_new(ring_name, UHD_RING_SLOT_NUM,
+                            monotonic + realtime_offset, monotonic);
+        if (ring == NULL)
+        {
+            GENERIC_FAILURE("create shared memory ring \"%s\": %s",
+                            ring_name, strerror(errno));
+            uhd_writer_free(writer);
+            return 1;
+        }
+    }
+    else if (format == DUMP_FORMAT_BINARY)
+    {
+        uhd_capture_header(header, monotonic + realtime_offset, monotonic);
+        uhd_writer_put(writer, header, sizeof(header));
+    }
+
     /* Run! */
-    result = run(dump_descriptor, dump_stream, stream_timeout,
-                 bus_num, dev_addr, vid, pid, iface_num);
+    result = run(dump_descriptor, dump_stream, stream_timeout, stream_queue,
+                 stream_stats, hotplug, bus_num, dev_addr, vid, pid,
+                 iface_num);
+
+    /* Flush the output and stop the writer */
+    if (uhd_writer_dropped(writer) > 0)
+        GENERIC_ERROR("%llu records dropped due to output overflow",
+                      (unsigned long long int)uhd_writer_dropped(writer));
+    uhd_writer_free(writer);
+    writer = NULL;
+
+    /* Let the ring readers know we're done */
+    uhd_ring_free(ring);
+    ring = NULL;
+
+    uhd_trigger_list_free(trigger_list);
+    trigger_list = NULL;
+
+    uhd_latency_free(latency);
+    latency = NULL;
 
     /*
      * Restore signal handlers
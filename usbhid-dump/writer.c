@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - output writer
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#include "writer.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+struct uhd_writer {
+    int                 fd;         /**< Output file descriptor */
+    uhd_writer_overflow overflow;   /**< Overflow policy */
+    uint8_t            *buf;        /**< Ring buffer */
+    size_t              size;       /**< Ring buffer size, power of two */
+    /*
+     * Head and tail are free-running byte counters, only ever advanced by
+     * the producer and the consumer respectively; the fill level is their
+     * difference.
+     */
+    size_t              head;       /**< Producer position */
+    size_t              tail;       /**< Consumer position */
+    uint64_t            dropped;    /**< Number of dropped records */
+    bool                stop;       /**< True if the thread should exit
+                                         once the ring is drained */
+    sem_t               sem;        /**< Posted for every record queued */
+    pthread_t           thread;     /**< Writer thread */
+    uhd_writer_format_fn
+                        format;     /**< Record formatting function, or
+                                         NULL to write records as is */
+    void               *format_data;/**< Formatting function data */
+    uint8_t            *rec;        /**< Record being formatted, as large
+                                         as the ring buffer */
+    uint8_t            *out;        /**< Formatted output buffer */
+    size_t              out_len;    /**< Formatted output length */
+};
+
+/** Formatted output buffer size, it's written out when full */
+#define UHD_WRITER_OUT_SIZE (64 * 1024)
+
+
+static void
+uhd_writer_copy_in(uhd_writer *writer, size_t pos, const void *buf, size_t len)
+{
+    size_t  off     = pos & (writer->size - 1);
+    size_t  part    = writer->size - off;
+
+    if (part > len)
+        part = len;
+    memcpy(writer->buf + off, buf, part);
+    memcpy(writer->buf, (const uint8_t *)buf + part, len - part);
+}
+
+
+static void
+uhd_writer_copy_out(const uhd_writer *writer, size_t pos, void *buf, size_t len)
+{
+    size_t  off     = pos & (writer->size - 1);
+    size_t  part    = writer->size - off;
+
+    if (part > len)
+        part = len;
+    memcpy(buf, writer->buf + off, part);
+    memcpy((uint8_t *)buf + part, writer->buf, len - part);
+}
+
+
+static void
+uhd_writer_write(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t rc;
+
+    while (len > 0)
+    {
+        rc = write(fd, buf, len);
+        if (rc < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            /* Nowhere to write to, discard the data */
+            return;
+        }
+        buf += rc;
+        len -= rc;
+    }
+}
+
+
+/*
+ * With a formatting function, every record in the ring is prefixed with
+ * its length, and is formatted and collected into the output buffer.
+ */
+static void
+uhd_writer_drain_format(uhd_writer *writer)
+{
+    size_t          head;
+    size_t          tail;
+    uint32_t        len;
+    const void     *out;
+    size_t          n;
+
+    tail = writer->tail;
+    while ((head = __atomic_load_n(&writer->head, __ATOMIC_ACQUIRE)) != tail)
+    {
+        for (; tail != head; tail += sizeof(len) + len)
+        {
+            uhd_writer_copy_out(writer, tail, &len, sizeof(len));
+            uhd_writer_copy_out(writer, tail + sizeof(len), writer->rec, len);
+            /* Make the space available as soon as possible */
+            __atomic_store_n(&writer->tail, tail + sizeof(len) + len,
+                             __ATOMIC_RELEASE);
+
+            n = writer->format(writer->rec, len, writer->format_data, &out);
+            if (writer->out_len + n > UHD_WRITER_OUT_SIZE)
+            {
+                uhd_writer_write(writer->fd, writer->out, writer->out_len);
+                writer->out_len = 0;
+            }
+            if (n > UHD_WRITER_OUT_SIZE)
+            {
+                uhd_writer_write(writer->fd, out, n);
+                continue;
+            }
+            memcpy(writer->out + writer->out_len, out, n);
+            writer->out_len += n;
+        }
+    }
+
+    uhd_writer_write(writer->fd, writer->out, writer->out_len);
+    writer->out_len = 0;
+}
+
+
+static void
+uhd_writer_drain(uhd_writer *writer)
+{
+    size_t          head;
+    size_t          tail;
+    size_t          off;
+    size_t          len;
+    struct iovec    iov[2];
+    int             iovcnt;
+    ssize_t         rc;
+
+    if (writer->format != NULL)
+    {
+        uhd_writer_drain_format(writer);
+        return;
+    }
+
+    tail = writer->tail;
+    while ((head = __atomic_load_n(&writer->head, __ATOMIC_ACQUIRE)) != tail)
+    {
+        /* Write everything available, in at most two pieces */
+        off = tail & (writer->size - 1);
+        len = head - tail;
+        iov[0].iov_base = writer->buf + off;
+        if (off + len <= writer->size)
+        {
+            iov[0].iov_len = len;
+            iovcnt = 1;
+        }
+        else
+        {
+            iov[0].iov_len = writer->size - off;
+            iov[1].iov_base = writer->buf;
+            iov[1].iov_len = len - iov[0].iov_len;
+            iovcnt = 2;
+        }
+
+        rc = writev(writer->fd, iov, iovcnt);
+        if (rc < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            /* Nowhere to write to, discard the data */
+            rc = len;
+        }
+
+        tail += rc;
+        __atomic_store_n(&writer->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+
+static void *
+uhd_writer_thread(void *arg)
+{
+    uhd_writer *writer = arg;
+
+    for (;;)
+    {
+        while (sem_wait(&writer->sem) < 0 && errno == EINTR);
+        uhd_writer_drain(writer);
+        if (__atomic_load_n(&writer->stop, __ATOMIC_ACQUIRE))
+        {
+            uhd_writer_drain(writer);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+
+uhd_writer *
+uhd_writer_new(int                  fd,
+               size_t               size,
+               uhd_writer_overflow  overflow,
+               uhd_writer_format_fn format,
+               void                *data)
+{
+    uhd_writer *writer;
+    sigset_t    set;
+    sigset_t    oldset;
+    int         rc;
+
+    writer = calloc(1, sizeof(*writer));
+    if (writer == NULL)
+        return NULL;
+
+    writer->fd          = fd;
+    writer->overflow    = overflow;
+    writer->format      = format;
+    writer->format_data = data;
+    for (writer->size = 4096; writer->size < size; writer->size <<= 1);
+
+    writer->buf = malloc(writer->size);
+    if (writer->buf == NULL)
+        goto cleanup;
+
+    if (format != NULL)
+    {
+        writer->rec = malloc(writer->size);
+        writer->out = malloc(UHD_WRITER_OUT_SIZE);
+        if (writer->rec == NULL || writer->out == NULL)
+            goto cleanup;
+    }
+
+    if (sem_init(&writer->sem, 0, 0) < 0)
+        goto cleanup;
+
+    /*
+     * Block all signals in the writer thread, so they keep interrupting
+     * the main thread's event handling. Except SIGPIPE, which is sent to
+     * the writing thread, and has to terminate the program when the
+     * output is closed, as it did before the writer thread.
+     */
+    sigfillset(&set);
+    sigdelset(&set, SIGPIPE);
+    pthread_sigmask(SIG_SETMASK, &set, &oldset);
+    rc = pthread_create(&writer->thread, NULL, uhd_writer_thread, writer);
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    if (rc != 0)
+    {
+        sem_destroy(&writer->sem);
+        goto cleanup;
+    }
+
+    return writer;
+
+cleanup:
+    free(writer->out);
+    free(writer->rec);
+    free(writer->buf);
+    free(writer);
+    return NULL;
+}
+
+
+bool
+uhd_writer_put(uhd_writer *writer, const void *buf, size_t len)
+{
+    static const struct timespec    wait    = {.tv_sec = 0,
+                                               .tv_nsec = 100000};
+    size_t                          head;
+    size_t                          need;
+    uint32_t                        frame;
+
+    assert(writer != NULL);
+    assert(buf != NULL || len == 0);
+
+    /* Formatted records are prefixed with their length */
+    need = writer->format != NULL ? sizeof(frame) + len : len;
+    if (len > writer->size || need > writer->size)
+        goto drop;
+
+    head = writer->head;
+    while (writer->size -
+           (head - __atomic_load_n(&writer->tail, __ATOMIC_ACQUIRE)) < need)
+    {
+        if (writer->overflow == UHD_WRITER_OVERFLOW_DROP)
+            goto drop;
+        /* Let the writer catch up */
+        sem_post(&writer->sem);
+        nanosleep(&wait, NULL);
+    }
+
+    if (writer->format != NULL)
+    {
+        frame = len;
+        uhd_writer_copy_in(writer, head, &frame, sizeof(frame));
+        uhd_writer_copy_in(writer, head + sizeof(frame), buf, len);
+    }
+    else
+        uhd_writer_copy_in(writer, head, buf, len);
+
+    __atomic_store_n(&writer->head, head + need, __ATOMIC_RELEASE);
+    sem_post(&writer->sem);
+
+    return true;
+
+drop:
+    __atomic_add_fetch(&writer->dropped, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+
+uint64_t
+uhd_writer_dropped(const uhd_writer *writer)
+{
+    assert(writer != NULL);
+    return __atomic_load_n(&writer->dropped, __ATOMIC_RELAXED);
+}
+
+
+void
+uhd_writer_free(uhd_writer *writer)
+{
+    if (writer == NULL)
+        return;
+
+    __atomic_store_n(&writer->stop, true, __ATOMIC_RELEASE);
+    sem_post(&writer->sem);
+    pthread_join(writer->thread, NULL);
+
+    sem_destroy(&writer->sem);
+    free(writer->out);
+    free(writer->rec);
+    free(writer->buf);
+    free(writer);
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * usbhid-dump - output writer
+ *
+ * Copyright (C) 2026 usbutils contributors
+ */
+
+#ifndef __UHD_WRITER_H__
+#define __UHD_WRITER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default output ring buffer size, bytes */
+#define UHD_WRITER_SIZE (1024 * 1024)
+
+/** What to do with a record which doesn't fit into the ring buffer */
+typedef enum uhd_writer_overflow {
+    UHD_WRITER_OVERFLOW_DROP,   /**< Drop the record and count it */
+    UHD_WRITER_OVERFLOW_BLOCK,  /**< Wait for the writer to make space */
+} uhd_writer_overflow;
+
+/**
+ * Record formatting function, called on the writer thread for every
+ * queued record, to produce the output written for it.
+ *
+ * @param rec   The record, as put into the writer.
+ * @param len   Record length.
+ * @param data  Formatting function data.
+ * @param out   Location for the output pointer, valid until the next call.
+ *
+ * @return Output length, zero to write nothing.
+ */
+typedef size_t (*uhd_writer_format_fn)(const uint8_t   *rec,
+                                       size_t           len,
+                                       void            *data,
+                                       const void     **out);
+
+/**
+ * usbhid-dump output writer.
+ *
+ * Records are copied into a lock-free single-producer single-consumer
+ * ring buffer and written out by a dedicated thread, in as large writev(2)
+ * calls as the ring contents allow. This keeps stdio and write syscalls
+ * out of the libusb transfer callbacks. With a formatting function, the
+ * records are raw data formatted on the writer thread too, and batched
+ * up before writing.
+ */
+typedef struct uhd_writer uhd_writer;
+
+/**
+ * Create a writer and start its thread.
+ *
+ * @param fd        File descriptor to write to.
+ * @param size      Ring buffer size, bytes, rounded up to a power of two.
+ * @param overflow  Overflow policy.
+ * @param format    Record formatting function, or NULL to write the
+ *                  records as they are.
+ * @param data      Formatting function data.
+ *
+ * @return New writer or NULL, if failed to allocate or start the thread.
+ */
+extern uhd_writer *uhd_writer_new(int                   fd,
+                                  size_t                size,
+                                  uhd_writer_overflow   overflow,
+                                  uhd_writer_format_fn  format,
+                                  void                 *data);
+
+/**
+ * Put a record into a writer. The record is either queued whole, or not at
+ * all. Must only be called from one thread at a time.
+ *
+ * @param writer    The writer to put the record into.
+ * @param buf       Record data.
+ * @param len       Record length.
+ *
+ * @return True if the record was queued, false if it was dropped.
+ */
+extern bool uhd_writer_put(uhd_writer *writer, const void *buf, size_t len);
+
+/**
+ * Retrieve the number of records dropped by a writer so far.
+ *
+ * @param writer    The writer to retrieve the counter from.
+ *
+ * @return The number of dropped records.
+ */
+extern uint64_t uhd_writer_dropped(const uhd_writer *writer);
+
+/**
+ * Flush all queued records, stop the writer thread and free the writer.
+ *
+ * @param writer    The writer to free, could be NULL.
+ */
+extern void uhd_writer_free(uhd_writer *writer);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __UHD_WRITER_H__ */
@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /* usbreset -- send a USB port reset to a USB device */
 /* Copyright (c) 2009-2016 Alan Stern */
-/* To build:  gcc -o usbreset usbreset.c */
+/* To build:  gcc -o usbreset usbreset.c -ludev -lpthread */
 
 #include <stdint.h>
 #include <stdio.h>
@@ -14,30 +14,46 @@
 #include <ctype.h>
 #include <limits.h>
 #include <dirent.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/ioctl.h>
 
 #include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/ch11.h>
+#include <libudev.h>
+
+#define SYSFS_USB_DEVICES	"/sys/bus/usb/devices"
+#define SYSFS_USB_DRIVERS_PROBE	"/sys/bus/usb/drivers_probe"
+
+/* How long to keep a port powered off, for the device to notice */
+#define PORT_POWER_OFF_MS	500
 
 struct usbentry {
 	int bus_num;
 	int dev_num;
 	int vendor_id;
 	int product_id;
+	char name[32];		/* sysfs name, i.e. the port path */
 	char vendor_name[128];
 	char product_name[128];
 	char serial[128];
+	char drivers[128];	/* interface drivers, comma-separated */
 };
 
-static char *sysfs_attr(const char *dev, const char *attr)
+/* dfd is an open /sys/bus/usb/devices, so the kernel only walks dev/attr */
+static char *sysfs_attr(int dfd, const char *dev, const char *attr)
 {
 	int fd, len = 0;
 	char path[PATH_MAX];
 	static char buf[129];
 
 	memset(buf, 0, sizeof(buf));
-	snprintf(path, sizeof(path) - 1, "/sys/bus/usb/devices/%s/%s", dev, attr);
+	snprintf(path, sizeof(path) - 1, "%s/%s", dev, attr);
 
-	fd = open(path, O_RDONLY);
+	fd = openat(dfd, path, O_RDONLY);
 	if (fd >= 0) {
 		len = read(fd, buf, sizeof(buf) - 1);
 		close(fd);
@@ -64,37 +80,39 @@ static struct usbentry *parse_devlist(DIR *d)
 
 		if (!e)
 			return NULL;
-	} while (!isdigit(e->d_name[0]) || strchr(e->d_name, ':'));
+	} while (!isdigit(e->d_name[0]) || strchr(e->d_name, ':') ||
+		 strlen(e->d_name) >= sizeof(dev.name));
 
 	memset(&dev, 0, sizeof(dev));
 	dev.vendor_id = -1;
 	dev.product_id = -1;
+	strcpy(dev.name, e->d_name);
 
-	attr = sysfs_attr(e->d_name, "busnum");
+	attr = sysfs_attr(dirfd(d), e->d_name, "busnum");
 	if (attr)
 		dev.bus_num = strtoul(attr, NULL, 10);
 
-	attr = sysfs_attr(e->d_name, "devnum");
+	attr = sysfs_attr(dirfd(d), e->d_name, "devnum");
 	if (attr)
 		dev.dev_num = strtoul(attr, NULL, 10);
 
-	attr = sysfs_attr(e->d_name, "idVendor");
+	attr = sysfs_attr(dirfd(d), e->d_name, "idVendor");
 	if (attr)
 		dev.vendor_id = strtoul(attr, NULL, 16);
 
-	attr = sysfs_attr(e->d_name, "idProduct");
+	attr = sysfs_attr(dirfd(d), e->d_name, "idProduct");
 	if (attr)
 		dev.product_id = strtoul(attr, NULL, 16);
 
-	attr = sysfs_attr(e->d_name, "manufacturer");
+	attr = sysfs_attr(dirfd(d), e->d_name, "manufacturer");
 	if (attr)
 		strncpy(dev.vendor_name, attr, sizeof(dev.vendor_name) - 1);
 
-	attr = sysfs_attr(e->d_name, "product");
+	attr = sysfs_attr(dirfd(d), e->d_name, "product");
 	if (attr)
 		strncpy(dev.product_name, attr, sizeof(dev.product_name) - 1);
 
-	attr = sysfs_attr(e->d_name, "serial");
+	attr = sysfs_attr(dirfd(d), e->d_name, "serial");
 	if (attr)
 		strncpy(dev.serial, attr, sizeof(dev.serial) - 1);
 
@@ -104,28 +122,204 @@ static struct usbentry *parse_devlist(DIR *d)
 	return NULL;
 }
 
+/* drivers is a comma separated list */
+static bool has_driver(const struct usbentry *e, const char *drv)
+{
+	size_t len = strlen(drv);
+	const char *p;
+
+	if (!len)
+		return false;
+	for (p = e->drivers; (p = strstr(p, drv)) != NULL; p++)
+		if ((p == e->drivers || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+			return true;
+
+	return false;
+}
+
+/* Append the drivers bound to the device's interfaces, each once */
+static void read_drivers(int dfd, struct usbentry *e)
+{
+	char path[PATH_MAX], link[PATH_MAX];
+	size_t len = strlen(e->name), used = 0;
+	struct dirent *ent;
+	const char *drv;
+	ssize_t n;
+	DIR *dir;
+	int fd;
+
+	fd = openat(dfd, e->name, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return;
+	dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return;
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, e->name, len) || ent->d_name[len] != ':')
+			continue;
+		snprintf(path, sizeof(path), "%s/driver", ent->d_name);
+		n = readlinkat(dirfd(dir), path, link, sizeof(link) - 1);
+		if (n < 0)
+			continue;
+		link[n] = '\0';
+		drv = strrchr(link, '/') ? strrchr(link, '/') + 1 : link;
+
+		if (has_driver(e, drv))
+			continue;
+		n = snprintf(e->drivers + used, sizeof(e->drivers) - used, "%s%s", used ? "," : "", drv);
+		if (n < 0 || (size_t)n >= sizeof(e->drivers) - used)
+			break;
+		used += n;
+	}
+	closedir(dir);
+}
+
+/*
+ * The devices found in a single sysfs scan, with hash tables to look them
+ * up by these keys, compared case-insensitively.
+ */
+enum index_key {
+	KEY_PORT,		/* port path, i.e. sysfs name */
+	KEY_BUSDEV,		/* BBB/DDD */
+	KEY_ID,			/* vvvv:pppp */
+	KEY_SERIAL,
+	KEY_PRODUCT,
+	KEY_NUM,
+};
+
+struct devindex {
+	struct usbentry *devs;
+	int count;
+	unsigned int mask;	/* number of buckets - 1 */
+	int *head[KEY_NUM];	/* first device in each bucket, or -1 */
+	int *next[KEY_NUM];	/* next device in the same bucket, or -1 */
+};
+
+static const char *entry_key(const struct usbentry *e, enum index_key key, char *buf, size_t size)
+{
+	switch (key) {
+	case KEY_PORT:
+		return e->name;
+	case KEY_BUSDEV:
+		snprintf(buf, size, "%03d/%03d", e->bus_num, e->dev_num);
+		return buf;
+	case KEY_ID:
+		snprintf(buf, size, "%04x:%04x", e->vendor_id, e->product_id);
+		return buf;
+	case KEY_SERIAL:
+		return e->serial;
+	default:
+		return e->product_name;
+	}
+}
+
+/* FNV-1a */
+static unsigned int key_hash(const char *key)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*key) {
+		hash ^= tolower((unsigned char)*key++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void index_free(struct devindex *idx)
+{
+	int k;
+
+	for (k = 0; k < KEY_NUM; k++) {
+		free(idx->head[k]);
+		free(idx->next[k]);
+	}
+	free(idx->devs);
+	memset(idx, 0, sizeof(*idx));
+}
+
+/* Scan sysfs into the index, reading the interface drivers too if asked */
+static int index_build(struct devindex *idx, bool drivers)
+{
+	DIR *devs = opendir(SYSFS_USB_DEVICES);
+	struct usbentry *e, *tmp;
+	char buf[32];
+	unsigned int b, buckets = 16;
+	int i, k, alloc = 0;
+
+	memset(idx, 0, sizeof(*idx));
+	if (!devs)
+		return -1;
+
+	while ((e = parse_devlist(devs)) != NULL) {
+		if (idx->count == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			tmp = realloc(idx->devs, alloc * sizeof(*tmp));
+			if (!tmp)
+				goto fail;
+			idx->devs = tmp;
+		}
+		if (drivers)
+			read_drivers(dirfd(devs), e);
+		idx->devs[idx->count++] = *e;
+	}
+	closedir(devs);
+	devs = NULL;
+
+	while (buckets < 2U * idx->count)
+		buckets *= 2;
+	idx->mask = buckets - 1;
+
+	for (k = 0; k < KEY_NUM; k++) {
+		idx->head[k] = malloc(buckets * sizeof(int));
+		idx->next[k] = malloc((idx->count + 1) * sizeof(int));
+		if (!idx->head[k] || !idx->next[k])
+			goto fail;
+		memset(idx->head[k], -1, buckets * sizeof(int));
+
+		/* Backwards, so the buckets list the devices in scan order */
+		for (i = idx->count - 1; i >= 0; i--) {
+			const char *key = entry_key(&idx->devs[i], k, buf, sizeof(buf));
+
+			idx->next[k][i] = -1;
+			if (!*key)
+				continue;
+			b = key_hash(key) & idx->mask;
+			idx->next[k][i] = idx->head[k][b];
+			idx->head[k][b] = i;
+		}
+	}
+
+	return 0;
+
+fail:
+	if (devs)
+		closedir(devs);
+	index_free(idx);
+	return -1;
+}
+
 static void list_devices(void)
 {
-	DIR *devs = opendir("/sys/bus/usb/devices");
+	struct devindex idx;
 	struct usbentry *dev;
-	int max_serial_length = 0;
+	int i, max_serial_length = 0;
 
-	if (!devs)
+	if (index_build(&idx, false) < 0)
 		return;
 
 	/* Calculate the largest size of the serial numbers if present */
-	while ((dev = parse_devlist(devs)) != NULL) {
-		int serial_length = strlen(dev->serial);
+	for (i = 0; i < idx.count; i++) {
+		int serial_length = strlen(idx.devs[i].serial);
 		if (serial_length > max_serial_length)
 			max_serial_length = serial_length;
 	}
-	closedir(devs);
 
-	devs = opendir("/sys/bus/usb/devices");
-	if (!devs)
-		return;
-
-	while ((dev = parse_devlist(devs)) != NULL) {
+	for (i = 0; i < idx.count; i++) {
+		dev = &idx.devs[i];
 		printf("  Number %03d/%03d  ID %04x:%04x  ", dev->bus_num, dev->dev_num, dev->vendor_id,
 		       dev->product_id);
 		if (strlen(dev->serial) > 0)
@@ -135,89 +329,968 @@ static void list_devices(void)
 		printf("  %s\n", dev->product_name);
 	}
 
-	closedir(devs);
+	index_free(&idx);
 }
 
-static struct usbentry *find_device(int *bus, int *dev, int *vid, int *pid, const char *serial, const char *product)
+/*
+ * A device selector given on the command line: a key to look up in the
+ * index, or one of the ones scanning all the devices.
+ */
+enum selector_type {
+	SEL_CONTAINS = KEY_NUM,	/* ~TEXT, product name contains it */
+	SEL_DRIVER,		/* DRV:DRIVER, an interface bound to it */
+};
+
+struct selector {
+	const char *arg;
+	int type;		/* enum index_key or enum selector_type */
+	char key[128];
+};
+
+static int parse_selector(struct selector *sel, const char *arg)
 {
-	DIR *devs = opendir("/sys/bus/usb/devices");
+	int id1, id2;
 
-	struct usbentry *e;
-	static struct usbentry match;
-	int found = 0;
+	memset(sel, 0, sizeof(*sel));
+	sel->arg = arg;
 
-	if (!devs)
-		return NULL;
-
-	while ((e = parse_devlist(devs)) != NULL)
-		if ((bus && (e->bus_num == *bus) && (e->dev_num == *dev)) ||
-		    (vid && (e->vendor_id == *vid) && (e->product_id == *pid)) ||
-		    (serial && !strcasecmp(e->serial, serial)) || (product && !strcasecmp(e->product_name, product))) {
-			if (found++) {
-				fprintf(stderr,
-					"Multiple devices match; specify the bus/device number (BBB/DDD).\n");
-				closedir(devs);
-				return NULL;
-			}
-			match = *e;
-		}
+	if (strncmp(arg, "SN:", 3) == 0) {
+		sel->type = KEY_SERIAL;
+		arg += 3;
+	} else if (strncmp(arg, "PORT:", 5) == 0) {
+		sel->type = KEY_PORT;
+		arg += 5;
+	} else if (strncmp(arg, "DRV:", 4) == 0) {
+		sel->type = SEL_DRIVER;
+		arg += 4;
+	} else if (arg[0] == '~') {
+		sel->type = SEL_CONTAINS;
+		arg++;
+	} else if (sscanf(arg, "%3d/%3d", &id1, &id2) == 2) {
+		sel->type = KEY_BUSDEV;
+		snprintf(sel->key, sizeof(sel->key), "%03d/%03d", id1, id2);
+		return 0;
+	} else if (sscanf(arg, "%4x:%4x", &id1, &id2) == 2) {
+		sel->type = KEY_ID;
+		snprintf(sel->key, sizeof(sel->key), "%04x:%04x", id1, id2);
+		return 0;
+	} else {
+		sel->type = KEY_PRODUCT;
+	}
 
-	closedir(devs);
+	if (!*arg || strlen(arg) >= sizeof(sel->key))
+		return -1;
+	strcpy(sel->key, arg);
 
-	return found ? &match : NULL;
+	return 0;
 }
 
-static void reset_device(struct usbentry *dev)
+static bool contains_nocase(const char *str, const char *text)
+{
+	size_t len = strlen(text);
+
+	for (; *str; str++)
+		if (!strncasecmp(str, text, len))
+			return true;
+
+	return false;
+}
+
+/* Store the indexes of the devices the selector matches, return how many */
+static int index_lookup(const struct devindex *idx, const struct selector *sel, int *matches)
+{
+	char buf[32];
+	int i, n = 0;
+
+	if (sel->type < KEY_NUM) {
+		for (i = idx->head[sel->type][key_hash(sel->key) & idx->mask]; i >= 0;
+		     i = idx->next[sel->type][i])
+			if (!strcasecmp(entry_key(&idx->devs[i], sel->type, buf, sizeof(buf)), sel->key))
+				matches[n++] = i;
+	} else {
+		for (i = 0; i < idx->count; i++)
+			if (sel->type == SEL_CONTAINS ? contains_nocase(idx->devs[i].product_name, sel->key) :
+							has_driver(&idx->devs[i], sel->key))
+				matches[n++] = i;
+	}
+
+	return n;
+}
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e3 + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Recovery actions, cheapest first, the order they're escalated in */
+enum reset_action {
+	ACTION_REBIND,		/* unbind and reprobe the interface drivers */
+	ACTION_AUTHORIZE,	/* deauthorize and authorize the device */
+	ACTION_RESET,		/* USBDEVFS_RESET */
+	ACTION_POWER,		/* power-cycle the hub port */
+	ACTION_NUM,
+};
+
+static const char *const action_names[ACTION_NUM] = { "rebind", "authorize", "reset", "power" };
+
+/* Phases of a reset, timed from its start */
+enum reset_phase {
+	PHASE_RESET,		/* USBDEVFS_RESET returned */
+	PHASE_GONE,		/* sysfs node disappeared, if it did */
+	PHASE_BACK,		/* sysfs node reappeared */
+	PHASE_READY,		/* interface drivers bound again */
+	PHASE_TOTAL,		/* ready, from the start of the first action */
+	PHASE_NUM,
+};
+
+static const char *const phase_names[PHASE_NUM] = { "reset", "gone", "back", "ready", "total" };
+
+/* Bucket i counts the times in [2^i, 2^(i+1)) microseconds */
+#define HIST_BUCKETS	32
+
+struct histogram {
+	unsigned long count;
+	double min, max, sum;	/* ms */
+	unsigned long bucket[HIST_BUCKETS];
+};
+
+/* Results of all the cycles of a device */
+struct reset_stats {
+	unsigned long cycles;
+	unsigned long failed;	/* resets failed */
+	unsigned long not_ready;	/* not ready in time */
+	unsigned long missing;	/* not there to reset */
+	unsigned long recovered[ACTION_NUM];	/* by the action */
+	struct histogram phase[PHASE_NUM];
+};
+
+static void hist_add(struct histogram *h, double ms)
+{
+	unsigned long us = ms * 1000;
+	int i = 0;
+
+	while (us > 1 && i < HIST_BUCKETS - 1) {
+		us >>= 1;
+		i++;
+	}
+	h->bucket[i]++;
+
+	if (!h->count || ms < h->min)
+		h->min = ms;
+	if (!h->count || ms > h->max)
+		h->max = ms;
+	h->sum += ms;
+	h->count++;
+}
+
+static void hist_print(const struct histogram *h, const char *name)
+{
+	int i;
+
+	if (!h->count)
+		return;
+
+	printf("  %-6s %lu times, min %.3f ms, avg %.3f ms, max %.3f ms\n",
+	       name, h->count, h->min, h->sum / h->count, h->max);
+	for (i = 0; i < HIST_BUCKETS; i++)
+		if (h->bucket[i])
+			printf("         < %10.3f ms  %lu\n", (2UL << i) / 1000.0, h->bucket[i]);
+}
+
+enum reset_state {
+	RESET_PENDING,		/* waiting for a free slot on its hub */
+	RESET_RUNNING,		/* USBDEVFS_RESET in progress */
+	RESET_WAITING,		/* waiting for the device to be ready again */
+	RESET_DONE,
+};
+
+struct reset_job {
+	struct usbentry dev;
+	char hub[32];		/* port path of the parent hub */
+	int drivers;		/* interfaces with a driver before the reset */
+	enum reset_state state;
+	int hub_bus;		/* parent hub, for power-cycling the port */
+	int hub_dev;
+	int port;
+	enum reset_action action;
+	bool escalate;		/* try the next action if this one fails */
+	int err;		/* errno of the reset, zero on success */
+	bool cant_open;		/* and it's from opening the device */
+	bool missing;		/* not found at the start of the cycle */
+	bool gone;		/* the device was seen disconnecting */
+	bool back;		/* and then seen again */
+	bool ready;
+	pthread_t thread;
+	int done_fd;		/* written to when the reset returns */
+	struct timespec first;	/* first action started */
+	struct timespec start;	/* reset started */
+	struct timespec reset;	/* reset returned */
+	struct timespec gone_ts;
+	struct timespec back_ts;
+	struct timespec end;	/* device ready, or given up on */
+	struct reset_stats stats;
+};
+
+/* Count the interfaces of a device with a driver bound, -1 if it's gone */
+static int count_drivers(const char *name)
+{
+	char path[PATH_MAX];
+	struct dirent *e;
+	size_t len = strlen(name);
+	int dfd, count = 0;
+	DIR *d;
+
+	snprintf(path, sizeof(path), SYSFS_USB_DEVICES "/%s", name);
+	d = opendir(path);
+	if (!d)
+		return -1;
+	dfd = dirfd(d);
+
+	/* Interfaces are subdirectories named "<port path>:<config>.<interface>" */
+	while ((e = readdir(d)) != NULL) {
+		if (strncmp(e->d_name, name, len) || e->d_name[len] != ':')
+			continue;
+		snprintf(path, sizeof(path), "%s/driver", e->d_name);
+		if (faccessat(dfd, path, F_OK, 0) == 0)
+			count++;
+	}
+
+	closedir(d);
+	return count;
+}
+
+/* The actions return zero on success, or an errno */
+static int sysfs_write(const char *path, const char *val)
+{
+	int fd, err = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return errno;
+	if (write(fd, val, strlen(val)) < 0)
+		err = errno;
+	close(fd);
+
+	return err;
+}
+
+static int reset_device(struct reset_job *job)
+{
+	char path[PATH_MAX];
+	int fd, err = 0;
+
+	snprintf(path, sizeof(path) - 1, "/dev/bus/usb/%03d/%03d", job->dev.bus_num, job->dev.dev_num);
+
+	fd = open(path, O_WRONLY);
+	job->cant_open = fd < 0;
+	if (fd < 0)
+		return errno;
+	if (ioctl(fd, USBDEVFS_RESET, 0) < 0)
+		err = errno;
+	close(fd);
+
+	return err;
+}
+
+/* Unbind the drivers of the interfaces, and let the kernel probe them again */
+static int rebind_device(const struct reset_job *job)
+{
+	const char *name = job->dev.name;
+	size_t len = strlen(name);
+	char path[PATH_MAX];
+	struct dirent *ent;
+	int err = 0, rebound = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), SYSFS_USB_DEVICES "/%s", name);
+	dir = opendir(path);
+	if (!dir)
+		return errno;
+
+	while (!err && (ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, name, len) || ent->d_name[len] != ':')
+			continue;
+		snprintf(path, sizeof(path), SYSFS_USB_DEVICES "/%s/%s/driver/unbind", name, ent->d_name);
+		if (access(path, F_OK))
+			continue;
+		err = sysfs_write(path, ent->d_name);
+		if (!err)
+			err = sysfs_write(SYSFS_USB_DRIVERS_PROBE, ent->d_name);
+		rebound++;
+	}
+	closedir(dir);
+
+	/* Nothing to rebind is no recovery */
+	return err ? err : rebound ? 0 : ENOENT;
+}
+
+/* Disconnecting the device logically, without touching the bus */
+static int authorize_device(const struct reset_job *job)
+{
+	char path[PATH_MAX];
+	int err;
+
+	snprintf(path, sizeof(path), SYSFS_USB_DEVICES "/%s/authorized", job->dev.name);
+
+	err = sysfs_write(path, "0");
+	if (!err)
+		err = sysfs_write(path, "1");
+
+	return err;
+}
+
+static int port_power(int fd, int port, bool on)
+{
+	struct usbdevfs_ctrltransfer ctrl = {
+		.bRequestType = USB_DIR_OUT | USB_RT_PORT,
+		.bRequest = on ? USB_REQ_SET_FEATURE : USB_REQ_CLEAR_FEATURE,
+		.wValue = USB_PORT_FEAT_POWER,
+		.wIndex = port,
+		.wLength = 0,
+		.timeout = 1000,
+		.data = NULL,
+	};
+
+	return ioctl(fd, USBDEVFS_CONTROL, &ctrl) < 0 ? errno : 0;
+}
+
+/*
+ * Power the device's port on its parent hub off and on again, with the hub
+ * class port feature requests.  Hubs with ganged power switching power all
+ * their ports at once.
+ */
+static int power_cycle_port(const struct reset_job *job)
 {
-	int fd;
 	char path[PATH_MAX];
+	int fd, err;
 
-	snprintf(path, sizeof(path) - 1, "/dev/bus/usb/%03d/%03d", dev->bus_num, dev->dev_num);
+	if (!job->hub_bus)
+		return ENOENT;
 
-	printf("Resetting %s ... ", dev->product_name);
+	snprintf(path, sizeof(path) - 1, "/dev/bus/usb/%03d/%03d", job->hub_bus, job->hub_dev);
 
 	fd = open(path, O_WRONLY);
-	if (fd > -1) {
-		if (ioctl(fd, USBDEVFS_RESET, 0) < 0)
-			printf("failed [%s]\n", strerror(errno));
+	if (fd < 0)
+		return errno;
+	err = port_power(fd, job->port, false);
+	if (!err) {
+		usleep(PORT_POWER_OFF_MS * 1000);
+		err = port_power(fd, job->port, true);
+	}
+	close(fd);
+
+	return err;
+}
+
+static void *reset_thread(void *arg)
+{
+	struct reset_job *job = arg;
+	ssize_t ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &job->start);
+	switch (job->action) {
+	case ACTION_REBIND:
+		job->err = rebind_device(job);
+		break;
+	case ACTION_AUTHORIZE:
+		job->err = authorize_device(job);
+		break;
+	case ACTION_POWER:
+		job->err = power_cycle_port(job);
+		break;
+	default:
+		job->err = reset_device(job);
+		break;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &job->reset);
+
+	/* Let the main loop know, by the job's address */
+	do
+		ret = write(job->done_fd, &job, sizeof(job));
+	while (ret < 0 && errno == EINTR);
+
+	return NULL;
+}
+
+static void mark_gone(struct reset_job *job)
+{
+	if (job->gone)
+		return;
+	job->gone = true;
+	clock_gettime(CLOCK_MONOTONIC, &job->gone_ts);
+}
+
+/*
+ * A device is ready when it's present again at the same port, with at least
+ * as many interfaces bound to drivers as before the reset.  If the reset
+ * failed with ENODEV the device is being re-enumerated, so it has to be
+ * seen disconnecting first.
+ */
+static void check_ready(struct reset_job *job)
+{
+	int drivers;
+
+	if (job->state != RESET_WAITING)
+		return;
+
+	drivers = count_drivers(job->dev.name);
+	if (drivers < 0) {
+		mark_gone(job);
+		return;
+	}
+	if ((job->err == ENODEV || job->action == ACTION_POWER) && !job->gone)
+		return;
+	if (job->gone && !job->back) {
+		job->back = true;
+		clock_gettime(CLOCK_MONOTONIC, &job->back_ts);
+	}
+	if (drivers < job->drivers)
+		return;
+
+	job->ready = true;
+	job->state = RESET_DONE;
+	clock_gettime(CLOCK_MONOTONIC, &job->end);
+}
+
+/* Account the outcome of a reset in the device's statistics */
+static void account(struct reset_job *job, int wait)
+{
+	struct reset_stats *st = &job->stats;
+
+	st->cycles++;
+	if (job->missing) {
+		st->missing++;
+		return;
+	}
+	if (job->err && job->err != ENODEV) {
+		st->failed++;
+		return;
+	}
+
+	hist_add(&st->phase[PHASE_RESET], elapsed_ms(&job->start, &job->reset));
+	if (job->gone)
+		hist_add(&st->phase[PHASE_GONE], elapsed_ms(&job->start, &job->gone_ts));
+	if (job->back)
+		hist_add(&st->phase[PHASE_BACK], elapsed_ms(&job->start, &job->back_ts));
+	if (job->ready)
+		hist_add(&st->phase[PHASE_READY], elapsed_ms(&job->start, &job->end));
+	if (job->ready && job->escalate)
+		hist_add(&st->phase[PHASE_TOTAL], elapsed_ms(&job->first, &job->end));
+	if (job->ready || !wait)
+		st->recovered[job->action]++;
+	else
+		st->not_ready++;
+}
+
+static void print_stats(const struct reset_job *job)
+{
+	const struct reset_stats *st = &job->stats;
+	int i;
+
+	printf("%s %s: %lu cycles, %lu failed, %lu not ready, %lu missing\n",
+	       job->dev.name, job->dev.product_name, st->cycles, st->failed, st->not_ready, st->missing);
+	if (job->escalate) {
+		printf("  recovered by");
+		for (i = 0; i < ACTION_NUM; i++)
+			printf(" %s %lu%s", action_names[i], st->recovered[i], i < ACTION_NUM - 1 ? "," : "\n");
+	}
+	for (i = 0; i < PHASE_NUM; i++)
+		hist_print(&st->phase[i], phase_names[i]);
+}
+
+/*
+ * Resetting a single device once prints what usbreset always printed, for
+ * the scripts parsing it.
+ */
+static bool plain_output;
+
+static void report(const struct reset_job *job, int wait)
+{
+	if (plain_output) {
+		printf("Resetting %s ... ", job->dev.product_name);
+		if (job->missing)
+			printf("can't open [%s]\n", strerror(ENOENT));
+		else if (job->cant_open)
+			printf("can't open [%s]\n", strerror(job->err));
+		else if (job->err)
+			printf("failed [%s]\n", strerror(job->err));
 		else
 			printf("ok\n");
+		return;
+	}
 
-		close(fd);
-	} else {
-		printf("can't open [%s]\n", strerror(errno));
+	printf("Resetting %03d/%03d %s ", job->dev.bus_num, job->dev.dev_num, job->dev.product_name);
+	if (job->action != ACTION_RESET || job->escalate)
+		printf("(%s) ", action_names[job->action]);
+	printf("... ");
+
+	if (job->missing)
+		printf("missing\n");
+	else if (job->err && job->err != ENODEV)
+		printf("failed [%s]\n", strerror(job->err));
+	else if (!wait)
+		printf("ok\n");
+	else if (job->ready)
+		printf("ok, ready after %.1f ms\n", elapsed_ms(&job->start, &job->end));
+	else
+		printf("ok, not ready after %d s\n", wait);
+}
+
+static int hub_busy(const struct reset_job *jobs, int count, const char *hub)
+{
+	int i, busy = 0;
+
+	for (i = 0; i < count; i++)
+		if ((jobs[i].state == RESET_RUNNING || jobs[i].state == RESET_WAITING) &&
+		    !strcmp(jobs[i].hub, hub))
+			busy++;
+
+	return busy;
+}
+
+/*
+ * Look a device up again by its port path, which stays the same across
+ * resets, unlike the device number, without scanning the whole bus.
+ */
+static bool refresh_device(int dfd, struct usbentry *dev)
+{
+	char *attr;
+
+	attr = sysfs_attr(dfd, dev->name, "busnum");
+	if (!attr)
+		return false;
+	dev->bus_num = strtoul(attr, NULL, 10);
+
+	attr = sysfs_attr(dfd, dev->name, "devnum");
+	if (!attr)
+		return false;
+	dev->dev_num = strtoul(attr, NULL, 10);
+
+	return dev->bus_num && dev->dev_num;
+}
+
+/*
+ * Find the hub the device is connected to, and the port: the port path is
+ * the hub's, or the root hub's bus number, followed by the port number.
+ */
+static void find_port(int dfd, struct reset_job *job)
+{
+	struct usbentry hub = { 0 };
+	const char *name = job->dev.name;
+	char *p;
+
+	job->hub_bus = 0;
+
+	p = strrchr(name, '.');
+	if (p)
+		snprintf(hub.name, sizeof(hub.name), "%.*s", (int)(p - name), name);
+	else if ((p = strchr(name, '-')) != NULL)
+		snprintf(hub.name, sizeof(hub.name), "usb%.*s", (int)(p - name), name);
+	else
+		return;
+
+	job->port = strtoul(p + 1, NULL, 10);
+	if (job->port && refresh_device(dfd, &hub)) {
+		job->hub_bus = hub.bus_num;
+		job->hub_dev = hub.dev_num;
+	}
+}
+
+/* Start over with the first action, or the given one */
+static void start_cycle(struct reset_job *job, enum reset_action action)
+{
+	job->state = RESET_PENDING;
+	job->action = action;
+	job->err = 0;
+	job->cant_open = false;
+	job->gone = job->back = job->ready = false;
+}
+
+/*
+ * Reset the devices concurrently, at most per_hub at a time on the same
+ * hub, and wait up to wait seconds for each to be ready again, watching
+ * the udev events of the usb subsystem through mon, if not NULL.  Only
+ * failures are reported if quiet.
+ */
+static int reset_devices(struct reset_job *jobs, int count, int per_hub, int wait,
+			 struct udev_monitor *mon, bool quiet)
+{
+	struct udev_device *udev_dev;
+	struct reset_job *job;
+	struct pollfd pfd[2];
+	struct timespec now;
+	const char *sysname, *action;
+	int pipe_fd[2];
+	int i, left = count, failed = 0;
+	int timeout;
+	size_t len;
+	char *p;
+
+	int dfd;
+
+	if (pipe(pipe_fd) < 0) {
+		perror("pipe");
+		return -1;
+	}
+
+	/* Forget the events of the previous cycle, if any */
+	while (mon && (udev_dev = udev_monitor_receive_device(mon)) != NULL)
+		udev_device_unref(udev_dev);
+
+	dfd = open(SYSFS_USB_DEVICES, O_RDONLY | O_DIRECTORY);
+
+	for (i = 0; i < count; i++) {
+		job = &jobs[i];
+		start_cycle(job, job->escalate ? 0 : job->action);
+		job->done_fd = pipe_fd[1];
+		job->missing = dfd < 0 || !refresh_device(dfd, &job->dev);
+		if (!job->missing && (job->action == ACTION_POWER || job->escalate))
+			find_port(dfd, job);
+		if (job->missing)
+			job->state = RESET_DONE;
+		job->drivers = count_drivers(job->dev.name);
+		/* The parent hub is the port path up to the last dot, or the root hub */
+		p = strrchr(job->dev.name, '.');
+		if (!p)
+			p = strrchr(job->dev.name, '-');
+		if (p && p != job->dev.name)
+			snprintf(job->hub, sizeof(job->hub), "%.*s", (int)(p - job->dev.name), job->dev.name);
+		else
+			snprintf(job->hub, sizeof(job->hub), "usb%d", job->dev.bus_num);
+	}
+
+	if (dfd >= 0)
+		close(dfd);
+
+	while (left > 0) {
+		/* Start the resets there's room for */
+		for (i = 0; i < count; i++) {
+			job = &jobs[i];
+			if (job->state != RESET_PENDING || hub_busy(jobs, count, job->hub) >= per_hub)
+				continue;
+			job->state = RESET_RUNNING;
+			if (job->action == 0 || !job->escalate)
+				clock_gettime(CLOCK_MONOTONIC, &job->first);
+			if (pthread_create(&job->thread, NULL, reset_thread, job)) {
+				clock_gettime(CLOCK_MONOTONIC, &job->start);
+				job->reset = job->start;
+				job->err = EAGAIN;
+				job->state = RESET_DONE;
+			}
+		}
+
+		/* Wait for a reset to return, an event, or the nearest deadline */
+		timeout = -1;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		for (i = 0; i < count; i++) {
+			double ms;
+
+			/* Don't block with some not reported yet */
+			if (jobs[i].state == RESET_DONE && jobs[i].done_fd >= 0)
+				timeout = 0;
+			if (jobs[i].state == RESET_RUNNING && wait && !mon)
+				ms = 10;
+			else if (jobs[i].state == RESET_WAITING)
+				ms = wait * 1000 - elapsed_ms(&jobs[i].start, &now);
+			else
+				continue;
+			if (ms < 0)
+				ms = 0;
+			/* Without udev events, check every so often */
+			if (!mon && ms > 10)
+				ms = 10;
+			if (timeout < 0 || ms < timeout)
+				timeout = ms;
+		}
+
+		pfd[0].fd = pipe_fd[0];
+		pfd[0].events = POLLIN;
+		pfd[1].fd = mon ? udev_monitor_get_fd(mon) : -1;
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, timeout) < 0 && errno != EINTR) {
+			perror("poll");
+			break;
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			if (read(pipe_fd[0], &job, sizeof(job)) == sizeof(job)) {
+				pthread_join(job->thread, NULL);
+				if ((job->err && job->err != ENODEV) || !wait) {
+					job->state = RESET_DONE;
+				} else {
+					job->state = RESET_WAITING;
+					check_ready(job);
+				}
+			}
+		}
+
+		if (pfd[1].revents & POLLIN) {
+			udev_dev = udev_monitor_receive_device(mon);
+			sysname = udev_dev ? udev_device_get_sysname(udev_dev) : NULL;
+			for (i = 0; sysname && i < count; i++) {
+				job = &jobs[i];
+				len = strlen(job->dev.name);
+				if (strncmp(sysname, job->dev.name, len) ||
+				    (sysname[len] != '\0' && sysname[len] != ':'))
+					continue;
+				action = udev_device_get_action(udev_dev);
+				if (sysname[len] == '\0' && action && !strcmp(action, "remove"))
+					mark_gone(job);
+				check_ready(job);
+			}
+			udev_device_unref(udev_dev);
+		}
+
+		/* Check the rest without events, and give up on the late ones */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		for (i = 0; i < count; i++) {
+			job = &jobs[i];
+			/* A power-cycled device may be gone before the action returns */
+			if (!mon && job->state == RESET_RUNNING && wait && count_drivers(job->dev.name) < 0)
+				mark_gone(job);
+			if (!mon)
+				check_ready(job);
+			if (job->state == RESET_WAITING && elapsed_ms(&job->start, &now) >= wait * 1000) {
+				job->state = RESET_DONE;
+				job->end = now;
+			}
+		}
+
+		/* Report the devices done */
+		for (i = 0; i < count; i++) {
+			job = &jobs[i];
+			if (job->state != RESET_DONE || job->done_fd < 0)
+				continue;
+
+			/* Escalate to the next action, if this one didn't help */
+			if (job->escalate && !job->missing && job->action < ACTION_NUM - 1 &&
+			    ((job->err && job->err != ENODEV) || (wait && !job->ready))) {
+				if (!quiet)
+					report(job, wait);
+				start_cycle(job, job->action + 1);
+				continue;
+			}
+
+			job->done_fd = -1;
+			account(job, wait);
+			if (job->missing || (job->err && job->err != ENODEV) || (wait && !job->ready)) {
+				failed++;
+				report(job, wait);
+			} else if (!quiet) {
+				report(job, wait);
+			}
+			left--;
+		}
 	}
+
+	close(pipe_fd[0]);
+	close(pipe_fd[1]);
+
+	return failed ? -1 : 0;
+}
+
+static void usage(void)
+{
+	printf("Usage:\n"
+	       "  usbreset [OPTION]... DEVICE...\n\n"
+	       "DEVICE is one of:\n"
+	       "  VVVV:PPPP  - reset by vendor and product id\n"
+	       "  BBB/DDD    - reset by bus and device number\n"
+	       "  SN:SERIAL  - reset by serial number\n"
+	       "  PORT:PATH  - reset by port path, e.g. 1-1.2\n"
+	       "  DRV:DRIVER - reset by interface driver name\n"
+	       "  ~TEXT      - reset by product name containing TEXT\n"
+	       "  \"Product\"  - reset by product name\n\n"
+	       "Options:\n"
+	       "  -j, --per-hub=N  reset at most N devices at a time on each hub (default 1)\n"
+	       "  -w, --wait=SECS  wait up to SECS for each device to be ready again,\n"
+	       "                   0 not to wait (default 10 with more than one DEVICE,\n"
+	       "                   --cycles or --action=escalate, 0 otherwise)\n"
+	       "  -c, --cycles=N   reset the devices N times, then print the timing\n"
+	       "                   histograms and failure counts (default 1)\n"
+	       "  -a, --action=ACT rebind, authorize, reset, power, or escalate to try\n"
+	       "                   them in that order until one helps (default reset)\n"
+	       "  -A, --all        reset all the devices a DEVICE matches, instead of\n"
+	       "                   requiring it to match exactly one\n\n"
+	       "Devices:\n");
+	list_devices();
 }
 
+static const struct option long_options[] = {
+	{ "per-hub", required_argument, NULL, 'j' },
+	{ "wait", required_argument, NULL, 'w' },
+	{ "cycles", required_argument, NULL, 'c' },
+	{ "action", required_argument, NULL, 'a' },
+	{ "all", no_argument, NULL, 'A' },
+	{ "help", no_argument, NULL, 'h' },
+	{ 0, 0, 0, 0 }
+};
+
 int main(int argc, char **argv)
 {
-	int id1, id2;
-	struct usbentry *dev;
+	struct selector *sels;
+	struct reset_job *jobs = NULL;
+	struct devindex idx = { 0 };
+	int *matches = NULL;
+	bool *queued = NULL;
+	bool all = false, drivers = false;
+	struct udev *udev = NULL;
+	struct udev_monitor *mon = NULL;
+	int per_hub = 1, wait = -1;
+	int action = ACTION_RESET;
+	bool escalate = false;
+	long cycles = 1, cycle;
+	int c, i, j, n, count, job_count = 0;
+	bool failed = false;
+	char *end;
+	int ret = 1;
 
-	if ((argc == 2) && (sscanf(argv[1], "%3d/%3d", &id1, &id2) == 2))
-		dev = find_device(&id1, &id2, NULL, NULL, NULL, NULL);
-	else if ((argc == 2) && (sscanf(argv[1], "%4x:%4x", &id1, &id2) == 2))
-		dev = find_device(NULL, NULL, &id1, &id2, NULL, NULL);
-	else if ((argc == 2) && (strncmp(argv[1], "SN:", 3) == 0))
-		dev = find_device(NULL, NULL, NULL, NULL, &(argv[1])[3], NULL);
-	else if ((argc == 2) && strlen(argv[1]) < 128)
-		dev = find_device(NULL, NULL, NULL, NULL, NULL, argv[1]);
-	else {
-		printf("Usage:\n"
-		       "  usbreset VVVV:PPPP - reset by vendor and product id\n"
-		       "  usbreset BBB/DDD   - reset by bus and device number\n"
-		       "  usbreset SN:SERIAL - reset by serial number\n"
-		       "  usbreset \"Product\" - reset by product name\n\n"
-		       "Devices:\n");
-		list_devices();
-		return 1;
+	while ((c = getopt_long(argc, argv, "j:w:c:a:Ah", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'j':
+			per_hub = strtol(optarg, &end, 10);
+			if (*end || per_hub < 1) {
+				fprintf(stderr, "Invalid per-hub limit \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		case 'w':
+			wait = strtol(optarg, &end, 10);
+			if (*end || wait < 0 || wait > 3600) {
+				fprintf(stderr, "Invalid wait \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		case 'c':
+			cycles = strtol(optarg, &end, 10);
+			if (*end || cycles < 1) {
+				fprintf(stderr, "Invalid cycle count \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		case 'a':
+			escalate = !strcmp(optarg, "escalate");
+			for (action = 0; !escalate && action < ACTION_NUM; action++)
+				if (!strcmp(optarg, action_names[action]))
+					break;
+			if (action == ACTION_NUM) {
+				fprintf(stderr, "Invalid action \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		case 'A':
+			all = true;
+			break;
+		default:
+			usage();
+			return 1;
+		}
 	}
 
-	if (!dev) {
-		fprintf(stderr, "No such device found\n");
+	count = argc - optind;
+	if (count < 1) {
+		usage();
 		return 1;
 	}
 
-	reset_device(dev);
-	return 0;
+	/*
+	 * One device is just reset, as usbreset always did; waiting only
+	 * makes sense when resetting several, soak testing or escalating.
+	 */
+	if (wait < 0)
+		wait = count > 1 || cycles > 1 || escalate ? 10 : 0;
+
+	sels = calloc(count, sizeof(*sels));
+	if (!sels) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (parse_selector(&sels[i], argv[optind + i]) < 0) {
+			usage();
+			goto out;
+		}
+		if (sels[i].type == SEL_DRIVER)
+			drivers = true;
+	}
+
+	/* Scan once, then look up each selector in the index */
+	if (index_build(&idx, drivers) < 0) {
+		fprintf(stderr, "Can't scan %s\n", SYSFS_USB_DEVICES);
+		goto out;
+	}
+
+	matches = calloc(idx.count + 1, sizeof(*matches));
+	queued = calloc(idx.count + 1, sizeof(*queued));
+	jobs = calloc(idx.count + 1, sizeof(*jobs));
+	if (!matches || !queued || !jobs) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+
+	/* Nothing is reset unless all the selectors match */
+	for (i = 0; i < count; i++) {
+		n = index_lookup(&idx, &sels[i], matches);
+		if (!n) {
+			fprintf(stderr, "No such device found: \"%s\"\n", sels[i].arg);
+			failed = true;
+		} else if (n > 1 && !all) {
+			fprintf(stderr,
+				"Multiple devices match \"%s\"; specify the bus/device number (BBB/DDD), or use --all.\n",
+				sels[i].arg);
+			failed = true;
+		}
+		if (failed)
+			continue;
+
+		/* Reset every device once, however many selectors matched it */
+		for (j = 0; j < n; j++) {
+			if (queued[matches[j]])
+				continue;
+			queued[matches[j]] = true;
+			jobs[job_count].dev = idx.devs[matches[j]];
+			jobs[job_count].action = action;
+			jobs[job_count++].escalate = escalate;
+		}
+	}
+	if (failed)
+		goto out;
+
+	/* Start listening before resetting anything, so no event is missed */
+	if (wait) {
+		udev = udev_new();
+		if (udev)
+			mon = udev_monitor_new_from_netlink(udev, "udev");
+		if (!mon || udev_monitor_filter_add_match_subsystem_devtype(mon, "usb", NULL) < 0 ||
+		    udev_monitor_enable_receiving(mon) < 0) {
+			fprintf(stderr, "Can't monitor udev events, polling sysfs instead\n");
+			udev_monitor_unref(mon);
+			mon = NULL;
+		}
+	}
+
+	plain_output = count == 1 && job_count == 1 && cycles == 1 && !escalate &&
+		       action == ACTION_RESET && !wait;
+
+	for (cycle = 0; cycle < cycles; cycle++)
+		if (reset_devices(jobs, job_count, per_hub, wait, mon, cycles > 1) < 0)
+			failed = true;
+
+	if (cycles > 1)
+		for (j = 0; j < job_count; j++)
+			print_stats(&jobs[j]);
+
+	/* Which used to be it, whatever the outcome */
+	ret = failed && !plain_output ? 1 : 0;
+
+out:
+	udev_monitor_unref(mon);
+	udev_unref(udev);
+	index_free(&idx);
+	free(matches);
+	free(queued);
+	free(sels);
+	free(jobs);
+	return ret;
 }